@@ -21,16 +21,25 @@
 #pragma once
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
+#include <whl/column.hpp>
 #include <whl/cons.hpp>
 #include <whl/container.hpp>
+#include <whl/csv.hpp>
 #include <whl/format.hpp>
 #include <whl/function.hpp>
+#include <whl/io.hpp>
+#include <whl/json.hpp>
 #include <whl/literals.hpp>
+#include <whl/log.hpp>
 #include <whl/meta.hpp>
 #include <whl/operation.hpp>
+#include <whl/parallel.hpp>
+#include <whl/pattern.hpp>
 #include <whl/pointer.hpp>
 #include <whl/print.hpp>
+#include <whl/scan.hpp>
 #include <whl/sequence.hpp>
+#include <whl/simd.hpp>
 #include <whl/string.hpp>
 #include <whl/type.hpp>
 
@@ -0,0 +1,538 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_COLUMN_HPP
+#define WHEEL_WHL_COLUMN_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "whl/io.hpp"
+#include "whl/operation.hpp"
+#include "whl/type.hpp"
+
+// Column file layout, all integers in native byte order:
+//
+//   header  | magic "WHLC", version, column count, row count
+//   columns | one descriptor per column
+//   blocks  | one block per column, each starting on a 64-byte boundary
+//
+// A plain block is the raw array of values. A delta block is the first value
+// followed by the differences narrowed to the smallest signed width that fits.
+// A dictionary block is the sorted distinct values followed by narrowed indices.
+
+namespace whl::io {
+
+enum class encoding : std::uint32_t {
+  plain,
+  delta,
+  dictionary,
+};
+
+namespace detail {
+
+inline constexpr char column_magic[4] = {'W', 'H', 'L', 'C'};
+
+inline constexpr std::uint32_t column_version = 1;
+
+inline constexpr std::size_t column_align = 64;
+
+struct column_file_header {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t columns;
+  std::uint32_t reserved;
+  std::uint64_t rows;
+};
+
+struct column_desc {
+  std::uint32_t kind;
+  std::uint32_t width;
+  std::uint32_t encoding;
+  std::uint32_t index_width;
+  std::uint64_t offset;
+  std::uint64_t bytes;
+  std::uint64_t dict_size;
+};
+
+template<typename T>
+constexpr inline std::uint32_t column_kind() {
+  if constexpr (std::is_floating_point_v<T>) {
+    return 3;
+  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+    return 2;
+  } else if constexpr (std::is_integral_v<T>) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+inline std::uint32_t index_width(std::uint64_t max) {
+  if (max <= 0xff) return 1;
+  if (max <= 0xffff) return 2;
+  if (max <= 0xffffffff) return 4;
+  return 8;
+}
+
+inline std::uint32_t signed_width(std::int64_t min, std::int64_t max) {
+  if (min >= INT8_MIN && max <= INT8_MAX) return 1;
+  if (min >= INT16_MIN && max <= INT16_MAX) return 2;
+  if (min >= INT32_MIN && max <= INT32_MAX) return 4;
+  return 8;
+}
+
+inline void put_int(std::vector<char> &out, std::int64_t val, std::uint32_t width) {
+  switch (width) {
+    case 1: {
+      auto v = static_cast<std::int8_t>(val);
+      out.insert(out.end(), reinterpret_cast<const char *>(&v), reinterpret_cast<const char *>(&v) + 1);
+      break;
+    }
+    case 2: {
+      auto v = static_cast<std::int16_t>(val);
+      out.insert(out.end(), reinterpret_cast<const char *>(&v), reinterpret_cast<const char *>(&v) + 2);
+      break;
+    }
+    case 4: {
+      auto v = static_cast<std::int32_t>(val);
+      out.insert(out.end(), reinterpret_cast<const char *>(&v), reinterpret_cast<const char *>(&v) + 4);
+      break;
+    }
+    default: {
+      out.insert(out.end(), reinterpret_cast<const char *>(&val), reinterpret_cast<const char *>(&val) + 8);
+      break;
+    }
+  }
+}
+
+template<typename Int>
+inline std::int64_t get_int(const char *p) {
+  auto v = Int{};
+  std::memcpy(&v, p, sizeof(Int));
+  return static_cast<std::int64_t>(v);
+}
+
+inline std::int64_t get_int(const char *p, std::uint32_t width) {
+  switch (width) {
+    case 1: return get_int<std::int8_t>(p);
+    case 2: return get_int<std::int16_t>(p);
+    case 4: return get_int<std::int32_t>(p);
+    default: return get_int<std::int64_t>(p);
+  }
+}
+
+inline std::uint64_t get_index(const char *p, std::uint32_t width) {
+  switch (width) {
+    case 1: return static_cast<std::uint8_t>(get_int<std::uint8_t>(p));
+    case 2: return static_cast<std::uint16_t>(get_int<std::uint16_t>(p));
+    case 4: return static_cast<std::uint32_t>(get_int<std::uint32_t>(p));
+    default: return static_cast<std::uint64_t>(get_int<std::uint64_t>(p));
+  }
+}
+
+template<typename T>
+inline column_desc encode_column(const std::vector<T> &values, encoding enc, std::vector<char> &block) {
+  static_assert(std::is_trivially_copyable_v<T>, "column values must be trivially copyable");
+  auto desc = column_desc{column_kind<T>(), sizeof(T), static_cast<std::uint32_t>(enc), 0, 0, 0, 0};
+  auto raw = reinterpret_cast<const char *>(values.data());
+  if constexpr (std::is_integral_v<T>) {
+    if (enc == encoding::delta && !values.empty()) {
+      auto lo = std::int64_t{}, hi = std::int64_t{};
+      for (std::size_t i = 1; i < values.size(); ++i) {
+        auto d = static_cast<std::int64_t>(static_cast<std::uint64_t>(values[i]) - static_cast<std::uint64_t>(values[i - 1]));
+        lo = std::min(lo, d);
+        hi = std::max(hi, d);
+      }
+      desc.index_width = signed_width(lo, hi);
+      block.insert(block.end(), raw, raw + sizeof(T));
+      for (std::size_t i = 1; i < values.size(); ++i) {
+        auto d = static_cast<std::int64_t>(static_cast<std::uint64_t>(values[i]) - static_cast<std::uint64_t>(values[i - 1]));
+        put_int(block, d, desc.index_width);
+      }
+      return desc;
+    }
+  } else {
+    if (enc == encoding::delta) throw std::invalid_argument("whl::io: delta encoding requires an integral column");
+  }
+  if constexpr (std::is_arithmetic_v<T>) {
+    if (enc == encoding::dictionary) {
+      // Floats are keyed by their bytes, so -0.0 and 0.0 stay apart and NaNs
+      // share an entry.
+      auto less = [](const T &a, const T &b) {
+        if constexpr (std::is_floating_point_v<T>) {
+          return std::memcmp(&a, &b, sizeof(T)) < 0;
+        } else {
+          return a < b;
+        }
+      };
+      auto dict = values;
+      std::sort(dict.begin(), dict.end(), less);
+      dict.erase(std::unique(dict.begin(), dict.end(), [&less](const T &a, const T &b) { return !less(a, b) && !less(b, a); }), dict.end());
+      desc.dict_size = dict.size();
+      desc.index_width = index_width(dict.empty() ? 0 : dict.size() - 1);
+      auto dict_raw = reinterpret_cast<const char *>(dict.data());
+      block.insert(block.end(), dict_raw, dict_raw + dict.size() * sizeof(T));
+      for (auto &&v : values) {
+        auto index = std::lower_bound(dict.begin(), dict.end(), v, less) - dict.begin();
+        put_int(block, index, desc.index_width);
+      }
+      return desc;
+    }
+  } else {
+    if (enc == encoding::dictionary) throw std::invalid_argument("whl::io: dictionary encoding requires an arithmetic column");
+  }
+  desc.encoding = static_cast<std::uint32_t>(encoding::plain);
+  block.insert(block.end(), raw, raw + values.size() * sizeof(T));
+  return desc;
+}
+
+template<typename T, typename = void>
+struct is_tuple_like : std::false_type {};
+
+template<typename T>
+struct is_tuple_like<T, decltype(std::tuple_size<T>::value, void())> : std::true_type {};
+
+template<typename Row, std::size_t... I>
+inline auto column_vectors(std::index_sequence<I...>) {
+  return std::tuple<std::vector<remove_cr_t<std::tuple_element_t<I, Row>>>...>{};
+}
+
+template<typename Vectors, typename Row, std::size_t... I>
+inline void push_row(Vectors &vectors, const Row &row, std::index_sequence<I...>) {
+  (..., std::get<I>(vectors).push_back(std::get<I>(row)));
+}
+
+template<typename Vectors, std::size_t... I>
+inline std::size_t write_column_file(const std::filesystem::path &path, const Vectors &vectors,
+                                     const std::vector<encoding> &encodings, std::index_sequence<I...>) {
+  constexpr auto n = sizeof...(I);
+  auto rows = std::get<0>(vectors).size();
+  auto blocks = std::array<std::vector<char>, n>{};
+  auto descs = std::array<column_desc, n>{
+      encode_column(std::get<I>(vectors), I < encodings.size() ? encodings[I] : encoding::plain, blocks[I])...};
+  auto aligned = [](std::uint64_t off) { return (off + column_align - 1) / column_align * column_align; };
+  auto offset = aligned(sizeof(column_file_header) + sizeof(column_desc) * n);
+  for (std::size_t i = 0; i < n; ++i) {
+    descs[i].offset = offset;
+    descs[i].bytes = blocks[i].size();
+    offset = aligned(offset + blocks[i].size());
+  }
+  auto header = column_file_header{{}, column_version, static_cast<std::uint32_t>(n), 0, rows};
+  std::memcpy(header.magic, column_magic, sizeof(header.magic));
+
+  // Streams do not report errno, so failures name the path only.
+  auto out = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  if (!out) throw std::ios_base::failure("whl::op::write_columns: cannot open " + path.string());
+  auto written = std::uint64_t{};
+  auto write = [&out, &written](const void *data, std::size_t size) {
+    out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    written += size;
+  };
+  auto pad = [&write, &written](std::uint64_t to) {
+    static constexpr char zeros[column_align] = {};
+    write(zeros, static_cast<std::size_t>(to - written));
+  };
+  write(&header, sizeof(header));
+  write(descs.data(), sizeof(column_desc) * n);
+  for (std::size_t i = 0; i < n; ++i) {
+    pad(descs[i].offset);
+    write(blocks[i].data(), blocks[i].size());
+  }
+  out.flush();
+  if (!out) throw std::ios_base::failure("whl::op::write_columns: cannot write " + path.string());
+  return rows;
+}
+
+} // namespace detail
+
+// Read-only, contiguous view of one column. Plain columns point straight into
+// the file mapping, encoded columns into a buffer decoded once on open.
+template<typename T>
+struct column {
+  public:
+  using value_type = T;
+  using element_type = const T;
+  using reference = const T &;
+  using const_reference = const T &;
+  using pointer = const T *;
+  using const_pointer = const T *;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using iterator = const_pointer;
+  using const_iterator = const_pointer;
+
+  private:
+  std::shared_ptr<const void> owner;
+  pointer ptr;
+  size_type size_;
+
+  public:
+  column() : owner{}, ptr{}, size_{} {}
+
+  column(std::shared_ptr<const void> owner, pointer ptr, size_type size)
+      : owner(std::move(owner)), ptr(ptr), size_(size) {}
+
+  const_reference operator[](size_type i) const {
+    return ptr[i];
+  }
+
+  pointer data() const noexcept {
+    return ptr;
+  }
+
+  size_type size() const noexcept {
+    return size_;
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  const_iterator begin() const noexcept {
+    return ptr;
+  }
+
+  const_iterator end() const noexcept {
+    return ptr + size_;
+  }
+
+  const_iterator cbegin() const noexcept {
+    return begin();
+  }
+
+  const_iterator cend() const noexcept {
+    return end();
+  }
+};
+
+template<typename... Ts>
+struct column_row_iter {
+  public:
+  using value_type = std::tuple<Ts...>;
+  using pointer = std::optional<value_type>;
+  using reference = value_type;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+
+  private:
+  std::shared_ptr<const std::tuple<column<Ts>...>> cols;
+  std::size_t index;
+
+  template<std::size_t... I>
+  value_type row(std::index_sequence<I...>) const {
+    return value_type{std::get<I>(*cols)[index]...};
+  }
+
+  public:
+  column_row_iter(std::shared_ptr<const std::tuple<column<Ts>...>> cols, std::size_t index)
+      : cols(std::move(cols)), index(index) {}
+
+  value_type operator*() const {
+    return row(std::index_sequence_for<Ts...>());
+  }
+
+  pointer operator->() const {
+    return **this;
+  }
+
+  column_row_iter &operator++() {
+    ++index;
+    return *this;
+  }
+
+  column_row_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator!=(const column_row_iter &it) const {
+    return !(*this == it);
+  }
+
+  bool operator==(const column_row_iter &it) const {
+    return index == it.index;
+  }
+};
+
+template<typename... Ts>
+struct column_file {
+  public:
+  using const_iterator = column_row_iter<Ts...>;
+  using iterator = const_iterator;
+  using value_type = typename iterator::value_type;
+  using size_type = std::size_t;
+
+  private:
+  std::shared_ptr<const std::tuple<column<Ts>...>> cols;
+  size_type rows_;
+
+  template<typename T>
+  static column<T> open_column(const std::shared_ptr<const mapped_file> &file, const detail::column_desc &desc, std::size_t rows) {
+    if (desc.kind != detail::column_kind<T>() || desc.width != sizeof(T)) {
+      throw std::runtime_error("whl::io::columns: column type mismatch");
+    }
+    if (desc.offset > file->size() || desc.bytes > file->size() - desc.offset) {
+      throw std::runtime_error("whl::io::columns: truncated column block");
+    }
+    auto block = file->data() + desc.offset;
+    auto enc = static_cast<encoding>(desc.encoding);
+    auto truncated = [&desc](std::uint64_t head, std::uint64_t count, std::uint64_t width) {
+      return head > desc.bytes || count > (desc.bytes - head) / width;
+    };
+    if (enc == encoding::plain) {
+      if (truncated(0, rows, sizeof(T))) throw std::runtime_error("whl::io::columns: truncated column block");
+      return column<T>{file, reinterpret_cast<const T *>(block), rows};
+    }
+    if (enc != encoding::dictionary && (enc != encoding::delta || !std::is_integral_v<T>)) {
+      throw std::runtime_error("whl::io::columns: unsupported column encoding");
+    }
+    if (desc.index_width != 1 && desc.index_width != 2 && desc.index_width != 4 && desc.index_width != 8) {
+      throw std::runtime_error("whl::io::columns: invalid index width");
+    }
+    if (enc == encoding::dictionary) {
+      if (desc.dict_size > desc.bytes / sizeof(T) || truncated(desc.dict_size * sizeof(T), rows, desc.index_width)) {
+        throw std::runtime_error("whl::io::columns: truncated column block");
+      }
+    } else if (enc == encoding::delta && rows > 0 && truncated(sizeof(T), rows - 1, desc.index_width)) {
+      throw std::runtime_error("whl::io::columns: truncated column block");
+    }
+    auto decoded = std::shared_ptr<T[]>(new T[rows]);
+    if (enc == encoding::dictionary) {
+      auto dict = reinterpret_cast<const T *>(block);
+      auto indices = block + desc.dict_size * sizeof(T);
+      for (std::size_t i = 0; i < rows; ++i) {
+        auto index = detail::get_index(indices + i * desc.index_width, desc.index_width);
+        if (index >= desc.dict_size) throw std::runtime_error("whl::io::columns: dictionary index out of range");
+        std::memcpy(&decoded[i], dict + index, sizeof(T));
+      }
+    } else if constexpr (std::is_integral_v<T>) {
+      if (rows > 0) std::memcpy(&decoded[0], block, sizeof(T));
+      auto deltas = block + sizeof(T);
+      for (std::size_t i = 1; i < rows; ++i) {
+        auto d = detail::get_int(deltas + (i - 1) * desc.index_width, desc.index_width);
+        decoded[i] = static_cast<T>(static_cast<std::uint64_t>(decoded[i - 1]) + static_cast<std::uint64_t>(d));
+      }
+    } else {
+      throw std::runtime_error("whl::io::columns: unsupported column encoding");
+    }
+    auto data = decoded.get();
+    return column<T>{std::move(decoded), data, rows};
+  }
+
+  template<std::size_t... I>
+  void open(const std::shared_ptr<const mapped_file> &file, const detail::column_desc *descs, std::index_sequence<I...>) {
+    cols = std::make_shared<const std::tuple<column<Ts>...>>(open_column<Ts>(file, descs[I], rows_)...);
+  }
+
+  public:
+  explicit column_file(const std::filesystem::path &path) {
+    auto file = std::make_shared<const mapped_file>(path);
+    auto header = detail::column_file_header{};
+    if (file->size() < sizeof(header)) throw std::runtime_error("whl::io::columns: not a column file");
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, detail::column_magic, sizeof(header.magic)) != 0 || header.version != detail::column_version) {
+      throw std::runtime_error("whl::io::columns: not a column file");
+    }
+    if (header.columns != sizeof...(Ts)) throw std::runtime_error("whl::io::columns: column count mismatch");
+    if (file->size() < sizeof(header) + sizeof(detail::column_desc) * sizeof...(Ts)) {
+      throw std::runtime_error("whl::io::columns: truncated header");
+    }
+    rows_ = header.rows;
+    auto descs = std::vector<detail::column_desc>(sizeof...(Ts));
+    std::memcpy(descs.data(), file->data() + sizeof(header), sizeof(detail::column_desc) * sizeof...(Ts));
+    open(file, descs.data(), std::index_sequence_for<Ts...>());
+  }
+
+  template<std::size_t I>
+  const auto &get() const noexcept {
+    return std::get<I>(*cols);
+  }
+
+  size_type size() const noexcept {
+    return rows_;
+  }
+
+  const_iterator begin() const {
+    return {cols, 0};
+  }
+
+  const_iterator end() const {
+    return {cols, rows_};
+  }
+
+  const_iterator cbegin() const {
+    return begin();
+  }
+
+  const_iterator cend() const {
+    return end();
+  }
+};
+
+// Opens a file written by `op::write_columns`, checking that its columns hold
+// exactly `Ts...`. Iterating it yields `std::tuple<Ts...>` rows.
+template<typename... Ts>
+inline auto columns(const std::filesystem::path &path) {
+  return column_file<Ts...>{path};
+}
+
+} // namespace whl::io
+
+namespace whl::op {
+
+// Writes tuple-like rows (or plain values, as a single column) to `path` in
+// the column file format, with an optional encoding per column. Returns the
+// number of rows written.
+inline auto write_columns(std::filesystem::path path, std::vector<io::encoding> encodings = {}) {
+  return operation{[path = std::move(path), encodings = std::move(encodings)](auto &&cont) {
+    using row_type = remove_cr_t<decltype(*std::begin(cont))>;
+    if constexpr (io::detail::is_tuple_like<row_type>::value) {
+      constexpr auto n = std::tuple_size_v<row_type>;
+      auto vectors = io::detail::column_vectors<row_type>(std::make_index_sequence<n>());
+      for (auto &&row : cont) {
+        io::detail::push_row(vectors, row, std::make_index_sequence<n>());
+      }
+      return io::detail::write_column_file(path, vectors, encodings, std::make_index_sequence<n>());
+    } else {
+      auto vectors = std::tuple<std::vector<row_type>>{};
+      std::get<0>(vectors).assign(std::begin(cont), std::end(cont));
+      return io::detail::write_column_file(path, vectors, encodings, std::make_index_sequence<1>());
+    }
+  }};
+}
+
+} // namespace whl::op
+
+#endif // WHEEL_WHL_COLUMN_HPP
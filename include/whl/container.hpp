@@ -22,6 +22,7 @@
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
 #include <cctype>
+#include <cstddef>
 #include <iterator>
 #include <type_traits>
 #include <utility>
@@ -190,6 +191,94 @@ struct array {
   }
 };
 
+template<typename T>
+struct span {
+  public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using reference = T &;
+  using const_reference = const T &;
+  using pointer = T *;
+  using const_pointer = const T *;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using iterator = pointer;
+  using const_iterator = pointer;
+
+  private:
+  pointer ptr;
+  size_type size_;
+
+  public:
+  constexpr span() noexcept : ptr{}, size_{} {}
+
+  constexpr span(pointer ptr, size_type size) noexcept : ptr{ptr}, size_{size} {}
+
+  constexpr span(pointer first, pointer last) noexcept : ptr{first}, size_(static_cast<size_type>(last - first)) {}
+
+  template<typename C, typename = std::enable_if_t<std::is_convertible_v<decltype(std::data(std::declval<C &>())), pointer>>>
+  constexpr span(C &cont) noexcept : ptr{std::data(cont)}, size_{std::size(cont)} {}
+
+  constexpr reference operator[](size_type i) const {
+    return ptr[i];
+  }
+
+  constexpr pointer data() const noexcept {
+    return ptr;
+  }
+
+  constexpr size_type size() const noexcept {
+    return size_;
+  }
+
+  constexpr bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  constexpr reference front() const {
+    return ptr[0];
+  }
+
+  constexpr reference back() const {
+    return ptr[size_ - 1];
+  }
+
+  constexpr span subspan(size_type offset, size_type count) const {
+    return {ptr + offset, count};
+  }
+
+  constexpr iterator begin() const noexcept {
+    return ptr;
+  }
+
+  constexpr iterator end() const noexcept {
+    return ptr + size_;
+  }
+
+  constexpr const_iterator cbegin() const noexcept {
+    return begin();
+  }
+
+  constexpr const_iterator cend() const noexcept {
+    return end();
+  }
+};
+
+template<typename C>
+span(C &) -> span<std::remove_pointer_t<decltype(std::data(std::declval<C &>()))>>;
+
+template<typename T, typename = void>
+struct is_contiguous : std::false_type {};
+
+// Containers exposing `std::data` with random-access iterators, e.g. vectors,
+// arrays, strings and the whl arrays.
+template<typename T>
+struct is_contiguous<T, std::enable_if_t<std::is_pointer_v<decltype(std::data(std::declval<T &>()))> && std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<decltype(std::begin(std::declval<T &>()))>::iterator_category>>>
+    : std::true_type {};
+
+template<typename T>
+inline constexpr bool is_contiguous_v = is_contiguous<T>::value;
+
 } // namespace whl
 
 #endif // WHEEL_WHL_CONTAINER_HPP
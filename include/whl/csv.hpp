@@ -0,0 +1,292 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_CSV_HPP
+#define WHEEL_WHL_CSV_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "whl/io.hpp"
+#include "whl/sequence.hpp"
+#include "whl/simd.hpp"
+
+namespace whl::io {
+
+namespace detail {
+
+// Bit i is set iff an odd number of bits at or below i are set in `x`.
+inline std::uint64_t prefix_xor(std::uint64_t x) noexcept {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+// Splits the text into rows 64 bytes at a time: quote, delimiter and newline
+// bitmasks are built with SIMD compares, the quoted regions are found with a
+// prefix xor of the quote mask, and the remaining separator bits are consumed
+// one by one with count-trailing-zeros.
+struct csv_parser {
+  std::shared_ptr<const mapped_file> file;
+  const char *data;
+  std::size_t size;
+  char delimiter, quote;
+
+  std::size_t block{};
+  std::uint64_t separators{}, newlines{}, in_quote{};
+  std::size_t field_start{};
+  std::vector<std::string_view> fields{};
+
+  csv_parser(std::shared_ptr<const mapped_file> file, std::string_view text, char delimiter, char quote)
+      : file(std::move(file)), data(text.data()), size(text.size()), delimiter(delimiter), quote(quote) {
+    load();
+  }
+
+  void load() noexcept {
+    auto p = data + block;
+    char tail[64];
+    if (size - block < 64) {
+      std::memset(tail, 0, sizeof(tail));
+      if (size > block) std::memcpy(tail, p, size - block);
+      p = tail;
+    }
+    auto quotes = simd::eq_mask64(p, quote);
+    auto delims = simd::eq_mask64(p, delimiter);
+    auto nls = simd::eq_mask64(p, '\n');
+    auto inside = prefix_xor(quotes) ^ in_quote;
+    in_quote = std::uint64_t{0} - (inside >> 63);
+    newlines = nls & ~inside;
+    separators = (delims | nls) & ~inside;
+    if (size - block < 64) {
+      auto valid = (std::uint64_t{1} << (size - block)) - 1;
+      newlines &= valid;
+      separators &= valid;
+    }
+  }
+
+  void push_field(std::size_t first, std::size_t last, bool at_newline) {
+    if (at_newline && last > first && data[last - 1] == '\r') --last;
+    if (last - first >= 2 && data[first] == quote && data[last - 1] == quote) {
+      ++first;
+      --last;
+    }
+    fields.emplace_back(data + first, last - first);
+  }
+
+  // Lines with nothing but an optional carriage return hold no row.
+  bool is_blank(std::size_t first, std::size_t last) const noexcept {
+    return first >= last || (last - first == 1 && data[first] == '\r');
+  }
+
+  bool next_row() {
+    fields.clear();
+    for (;;) {
+      while (separators == 0) {
+        if (block + 64 >= size) {
+          if (fields.empty() && is_blank(field_start, size)) return false;
+          push_field(field_start, size, true);
+          field_start = size;
+          return true;
+        }
+        block += 64;
+        load();
+      }
+      auto bit = simd::ctz(separators);
+      separators &= separators - 1;
+      auto pos = block + static_cast<std::size_t>(bit);
+      auto at_newline = ((newlines >> bit) & 1) != 0;
+      if (at_newline && fields.empty() && is_blank(field_start, pos)) {
+        field_start = pos + 1;
+        continue;
+      }
+      push_field(field_start, pos, at_newline);
+      field_start = pos + 1;
+      if (at_newline) return true;
+    }
+  }
+};
+
+} // namespace detail
+
+// One parsed record. Fields are views of the input without their surrounding
+// quotes, embedded quotes still doubled; they are valid until the iterator
+// that produced the row is advanced.
+struct csv_row {
+  public:
+  using value_type = std::string_view;
+  using const_iterator = std::vector<std::string_view>::const_iterator;
+  using iterator = const_iterator;
+  using size_type = std::size_t;
+
+  private:
+  const std::vector<std::string_view> *fields;
+  char quote;
+
+  public:
+  csv_row(const std::vector<std::string_view> *fields, char quote) : fields(fields), quote(quote) {}
+
+  std::string_view operator[](size_type i) const {
+    return (*fields)[i];
+  }
+
+  size_type size() const noexcept {
+    return fields->size();
+  }
+
+  const_iterator begin() const noexcept {
+    return fields->begin();
+  }
+
+  const_iterator end() const noexcept {
+    return fields->end();
+  }
+
+  // Converts field `i`: numbers with `std::from_chars`, `bool` from
+  // true/false/1/0, `std::string` with doubled quotes collapsed,
+  // `std::string_view` as is.
+  template<typename T>
+  T get(size_type i) const {
+    auto field = (*fields)[i];
+    if constexpr (std::is_same_v<T, std::string_view>) {
+      return field;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      auto result = std::string{};
+      result.reserve(field.size());
+      for (size_type j = 0; j < field.size(); ++j) {
+        result.push_back(field[j]);
+        if (field[j] == quote && j + 1 < field.size() && field[j + 1] == quote) ++j;
+      }
+      return result;
+    } else if constexpr (std::is_same_v<T, bool>) {
+      if (field == "true" || field == "1") return true;
+      if (field == "false" || field == "0") return false;
+      throw std::invalid_argument("whl::io::csv: bad field '" + std::string(field) + "'");
+    } else {
+      static_assert(std::is_arithmetic_v<T>, "csv fields convert to numbers, bool or strings");
+      auto value = T{};
+      auto first = field.data(), last = field.data() + field.size();
+      if (first != last && *first == '+') ++first;
+      auto [ptr, ec] = std::from_chars(first, last, value);
+      if (ec != std::errc{} || ptr != last) {
+        throw std::invalid_argument("whl::io::csv: bad field '" + std::string(field) + "'");
+      }
+      return value;
+    }
+  }
+
+  template<typename... Ts>
+  std::tuple<Ts...> as() const {
+    return as<Ts...>(std::index_sequence_for<Ts...>());
+  }
+
+  private:
+  template<typename... Ts, std::size_t... I>
+  std::tuple<Ts...> as(std::index_sequence<I...>) const {
+    return std::tuple<Ts...>{get<Ts>(I)...};
+  }
+};
+
+struct csv_iter {
+  public:
+  using value_type = csv_row;
+  using pointer = std::optional<value_type>;
+  using reference = value_type;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+
+  private:
+  static constexpr auto npos = static_cast<std::size_t>(-1);
+
+  std::shared_ptr<detail::csv_parser> parser{};
+  std::size_t row{npos};
+
+  public:
+  csv_iter() = default;
+
+  explicit csv_iter(std::shared_ptr<detail::csv_parser> p) : parser(std::move(p)), row(0) {
+    if (!parser->next_row()) row = npos;
+  }
+
+  value_type operator*() const {
+    return {&parser->fields, parser->quote};
+  }
+
+  pointer operator->() const {
+    return **this;
+  }
+
+  csv_iter &operator++() {
+    row = parser->next_row() ? row + 1 : npos;
+    return *this;
+  }
+
+  csv_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator!=(const csv_iter &it) const {
+    return !(*this == it);
+  }
+
+  bool operator==(const csv_iter &it) const {
+    return row == it.row;
+  }
+};
+
+// Records of the delimiter separated text `text`, which must outlive the rows.
+inline auto parse_csv(std::string_view text, char delimiter = ',', char quote = '"') {
+  auto parser = std::make_shared<detail::csv_parser>(nullptr, text, delimiter, quote);
+  return sequence{csv_iter{std::move(parser)}, csv_iter{}};
+}
+
+// Records of the delimiter separated file at `path`, read through a mapping.
+inline auto csv(const std::filesystem::path &path, char delimiter = ',', char quote = '"') {
+  auto file = std::make_shared<const mapped_file>(path);
+  auto text = std::string_view(file->data(), file->size());
+  auto parser = std::make_shared<detail::csv_parser>(std::move(file), text, delimiter, quote);
+  return sequence{csv_iter{std::move(parser)}, csv_iter{}};
+}
+
+inline auto tsv(const std::filesystem::path &path) {
+  return csv(path, '\t');
+}
+
+} // namespace whl::io
+
+#endif // WHEEL_WHL_CSV_HPP
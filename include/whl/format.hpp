@@ -22,9 +22,19 @@
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <ostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -33,166 +43,879 @@
 
 namespace whl {
 
+// Customization point: `operator()(arg, out, first, last)` writes `arg` to the
+// output iterator `out` and returns the advanced iterator; [first, last) is
+// the spec between the braces of its placeholder. The fallback streams the
+// argument through an ostringstream.
 template<typename T, typename = void>
 struct formatter {
 
-  template<typename Out, typename FmtIter>
-  void operator()(const T &arg, Out &out, FmtIter first, FmtIter last) {
-    out << arg;
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(const T &arg, OutIt out, FmtIter first, FmtIter last);
+};
+
+// Growable character buffer that keeps the first `N` characters inline, so
+// that formatting short text does not allocate.
+template<typename Char, std::size_t N = 500>
+struct basic_memory_buffer {
+  public:
+  using value_type = Char;
+  using iterator = Char *;
+  using const_iterator = const Char *;
+  using size_type = std::size_t;
+
+  private:
+  Char store[N];
+  Char *ptr = store;
+  size_type size_{};
+  size_type capacity_ = N;
+  std::unique_ptr<Char[]> heap{};
+
+  public:
+  basic_memory_buffer() = default;
+
+  basic_memory_buffer(const basic_memory_buffer &) = delete;
+
+  basic_memory_buffer(basic_memory_buffer &&buffer) noexcept
+      : size_(buffer.size_), capacity_(buffer.capacity_), heap(std::move(buffer.heap)) {
+    if (heap) {
+      ptr = heap.get();
+    } else {
+      std::copy(buffer.store, buffer.store + size_, store);
+    }
+    buffer.ptr = buffer.store;
+    buffer.size_ = 0;
+    buffer.capacity_ = N;
+  }
+
+  void reserve(size_type n) {
+    if (n <= capacity_) return;
+    auto capacity = std::max(n, capacity_ * 2);
+    auto grown = std::unique_ptr<Char[]>{new Char[capacity]};
+    std::copy(ptr, ptr + size_, grown.get());
+    heap = std::move(grown);
+    ptr = heap.get();
+    capacity_ = capacity;
+  }
+
+  void resize(size_type n) {
+    reserve(n);
+    size_ = n;
+  }
+
+  void push_back(Char ch) {
+    if (size_ == capacity_) reserve(size_ + 1);
+    ptr[size_++] = ch;
+  }
+
+  void append(const Char *first, const Char *last) {
+    auto n = static_cast<size_type>(last - first);
+    reserve(size_ + n);
+    std::copy(first, last, ptr + size_);
+    size_ += n;
+  }
+
+  void clear() noexcept {
+    size_ = 0;
+  }
+
+  Char *data() noexcept {
+    return ptr;
+  }
+
+  const Char *data() const noexcept {
+    return ptr;
+  }
+
+  size_type size() const noexcept {
+    return size_;
+  }
+
+  size_type capacity() const noexcept {
+    return capacity_;
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  Char &operator[](size_type i) noexcept {
+    return ptr[i];
+  }
+
+  const Char &operator[](size_type i) const noexcept {
+    return ptr[i];
+  }
+
+  iterator begin() noexcept {
+    return ptr;
+  }
+
+  iterator end() noexcept {
+    return ptr + size_;
+  }
+
+  const_iterator begin() const noexcept {
+    return ptr;
+  }
+
+  const_iterator end() const noexcept {
+    return ptr + size_;
+  }
+
+  std::basic_string_view<Char> view() const noexcept {
+    return {ptr, size_};
+  }
+
+  std::basic_string<Char> str() const {
+    return {ptr, size_};
+  }
+};
+
+using memory_buffer = basic_memory_buffer<char>;
+using wmemory_buffer = basic_memory_buffer<wchar_t>;
+
+template<typename OutIt>
+struct format_to_n_result {
+  OutIt out;
+  std::size_t size;
+};
+
+namespace detail {
+
+// Output iterator appending to a `basic_memory_buffer`, whole strings at once.
+template<typename Buffer>
+struct buffer_appender {
+  using iterator_category = std::output_iterator_tag;
+  using value_type = void;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = void;
+  using char_type = typename Buffer::value_type;
+
+  Buffer *buffer;
+
+  buffer_appender &operator=(char_type ch) {
+    buffer->push_back(ch);
+    return *this;
+  }
+
+  buffer_appender &operator*() {
+    return *this;
+  }
+
+  buffer_appender &operator++() {
+    return *this;
+  }
+
+  buffer_appender &operator++(int) {
+    return *this;
+  }
+};
+
+// Writes the first `limit` characters to `out` and counts all of them.
+template<typename OutIt, typename Char>
+struct truncating_iterator {
+  using iterator_category = std::output_iterator_tag;
+  using value_type = void;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = void;
+  using char_type = Char;
+
+  OutIt out;
+  std::size_t limit, count;
+
+  truncating_iterator &operator=(char_type ch) {
+    if (count++ < limit) *out++ = ch;
+    return *this;
+  }
+
+  truncating_iterator &operator*() {
+    return *this;
+  }
+
+  truncating_iterator &operator++() {
+    return *this;
+  }
+
+  truncating_iterator &operator++(int) {
+    return *this;
+  }
+};
+
+template<typename Char>
+struct counting_iterator {
+  using iterator_category = std::output_iterator_tag;
+  using value_type = void;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = void;
+  using char_type = Char;
+
+  std::size_t count;
+
+  counting_iterator &operator=(char_type) {
+    ++count;
+    return *this;
+  }
+
+  counting_iterator &operator*() {
+    return *this;
+  }
+
+  counting_iterator &operator++() {
+    return *this;
+  }
+
+  counting_iterator &operator++(int) {
+    return *this;
+  }
+};
+
+// Character type written through an output iterator.
+template<typename OutIt, typename = void>
+struct out_char {
+  using type = char;
+};
+
+template<typename OutIt>
+struct out_char<OutIt, std::void_t<typename OutIt::container_type>> {
+  using type = typename OutIt::container_type::value_type;
+};
+
+template<typename OutIt>
+struct out_char<OutIt, std::void_t<typename OutIt::char_type>> {
+  using type = typename OutIt::char_type;
+};
+
+template<typename Char>
+struct out_char<Char *, void> {
+  using type = Char;
+};
+
+template<typename OutIt>
+using out_char_t = typename out_char<OutIt>::type;
+
+template<typename T>
+struct is_buffer_appender : std::false_type {};
+
+template<typename Buffer>
+struct is_buffer_appender<buffer_appender<Buffer>> : std::true_type {};
+
+template<typename OutIt, typename Char>
+inline OutIt write_str(OutIt out, const Char *first, const Char *last) {
+  if constexpr (is_buffer_appender<OutIt>::value && std::is_same_v<Char, out_char_t<OutIt>>) {
+    out.buffer->append(first, last);
+    return out;
+  } else {
+    return std::copy(first, last, out);
+  }
+}
+
+template<typename OutIt, typename Char>
+inline OutIt write_str(OutIt out, std::basic_string_view<Char> str) {
+  return write_str(out, str.data(), str.data() + str.size());
+}
+
+// Formats each argument with an empty spec.
+template<typename OutIt, typename... Args>
+inline OutIt write_args(OutIt out, const Args &...args) {
+  const out_char_t<OutIt> *none = nullptr;
+  (..., (out = formatter<Args>()(args, out, none, none)));
+  return out;
+}
+
+template<typename Char, typename Traits, typename... Args>
+inline void out_to(std::basic_ostream<Char, Traits> &out, const Args &...args) {
+  write_args(std::ostreambuf_iterator<Char, Traits>(out), args...);
+}
+
+template<typename Char, std::size_t N, typename... Args>
+inline void out_to(basic_memory_buffer<Char, N> &out, const Args &...args) {
+  write_args(buffer_appender<basic_memory_buffer<Char, N>>{&out}, args...);
+}
+
+// A literal run of the format string, or the spec between the braces of a
+// placeholder, as offsets into the string. `{{` and `}}` give one-character
+// literals.
+struct fmt_piece {
+  std::size_t first, size;
+  bool placeholder;
+  std::size_t index;
+};
+
+// Reads the piece at `pos` and returns the position after it, or npos at an
+// unmatched brace.
+template<typename Char>
+constexpr std::size_t next_piece(std::basic_string_view<Char> fmt, std::size_t pos, fmt_piece &piece) {
+  if (fmt[pos] == '{') {
+    if (pos + 1 < fmt.size() && fmt[pos + 1] == '{') {
+      piece = {pos, 1, false, std::string_view::npos};
+      return pos + 2;
+    }
+    auto close = fmt.find('}', pos + 1);
+    if (close == std::string_view::npos) return std::string_view::npos;
+    piece = {pos + 1, close - pos - 1, true, std::string_view::npos};
+    return close + 1;
+  }
+  if (fmt[pos] == '}') {
+    if (pos + 1 < fmt.size() && fmt[pos + 1] == '}') {
+      piece = {pos, 1, false, std::string_view::npos};
+      return pos + 2;
+    }
+    return std::string_view::npos;
+  }
+  auto end = std::min(fmt.find('{', pos), fmt.find('}', pos));
+  end = end == std::string_view::npos ? fmt.size() : end;
+  piece = {pos, end - pos, false, std::string_view::npos};
+  return end;
+}
+
+// Unmatched braces throw, which is a compile error in constant evaluation.
+constexpr std::size_t count_pieces(std::string_view fmt) {
+  auto n = std::size_t{};
+  for (auto pos = std::size_t{}; pos < fmt.size(); ++n) {
+    auto piece = fmt_piece{};
+    pos = next_piece(fmt, pos, piece);
+    if (pos == std::string_view::npos) throw std::invalid_argument("whl::format: unmatched brace");
+  }
+  return n;
+}
+
+template<std::size_t N>
+constexpr auto parse_pieces(std::string_view fmt) {
+  auto pieces = std::array<fmt_piece, N>{};
+  auto pos = std::size_t{}, args = std::size_t{};
+  for (auto &&piece : pieces) {
+    pos = next_piece(fmt, pos, piece);
+    if (piece.placeholder) piece.index = args++;
+  }
+  return pieces;
+}
+
+template<std::size_t N>
+constexpr std::size_t count_placeholders(const std::array<fmt_piece, N> &pieces) {
+  auto n = std::size_t{};
+  for (auto &&piece : pieces) {
+    n += piece.placeholder ? 1 : 0;
+  }
+  return n;
+}
+
+} // namespace detail
+
+// A format string known at compile time, see `WHL_FMT`. It is split into
+// literal and placeholder pieces during compilation, so formatting only
+// writes the precomputed literals and converts the arguments.
+template<typename Str>
+struct fmt {
+  static constexpr std::string_view str = Str::value();
+  static constexpr auto pieces = detail::parse_pieces<detail::count_pieces(str)>(str);
+  static constexpr std::size_t args = detail::count_placeholders(pieces);
+};
+
+template<typename T>
+struct is_fmt : std::false_type {};
+
+template<typename Str>
+struct is_fmt<fmt<Str>> : std::true_type {};
+
+// `WHL_FMT("{} + {}")` is a `whl::fmt` for the literal.
+#define WHL_FMT(s)                                                                                                     \
+  ([] {                                                                                                                \
+    struct whl_fmt_str {                                                                                               \
+      static constexpr std::string_view value() {                                                                      \
+        return s;                                                                                                      \
+      }                                                                                                                \
+    };                                                                                                                 \
+    return ::whl::fmt<whl_fmt_str>{};                                                                                  \
+  }())
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+template<std::size_t N>
+struct fixed_string {
+  char data[N]{};
+
+  constexpr fixed_string(const char (&s)[N]) {
+    std::copy(s, s + N, data);
   }
 };
 
+template<fixed_string S>
+struct fixed_str {
+  static constexpr std::string_view value() {
+    return {S.data, sizeof(S.data) - 1};
+  }
+};
+#endif
+
 namespace detail {
 
-template<typename Out, typename FmtIter, typename Arg, typename... Args>
-inline void format_to(Out &out, FmtIter first, FmtIter last, const Arg &arg, const Args &...args) {
-  if (first == last) return;
-  auto &&begin = std::find(first, last, '{');
-  while (begin != last && begin + 1 != last && *(begin + 1) == '{') {
-    begin = std::find(begin + 2, last, '{');
-  }
-  if (begin == last) {
-    std::for_each(first, last, [&out](auto &&it) { out << it; });
-    return;
-  }
-  auto &&end = std::find(begin + 1, last, '}');
-  while (end != last && end + 1 != last && *(end + 1) == '}') {
-    begin = std::find(end + 2, last, '}');
-  }
-  if (end == last) {
-    std::for_each(first, last, [&out](auto &&it) { out << it; });
-    return;
-  }
-  std::for_each(first, begin, [&out](auto &&it) { out << it; });
-  formatter<Arg>()(arg, out, begin + 1, end);
-  if constexpr (sizeof...(args) != 0) {
-    if (end + 1 != last) format_to(out, end + 1, last, args...);
+template<typename OutIt, typename Char, typename Arg, typename... Args>
+inline OutIt format_nth(OutIt out, std::size_t i, const Char *first, const Char *last, const Arg &arg, const Args &...args) {
+  if (i == 0) return formatter<Arg>()(arg, out, first, last);
+  if constexpr (sizeof...(Args) != 0) {
+    return format_nth(out, i - 1, first, last, args...);
+  } else {
+    return out;
+  }
+}
+
+// Parses the format string while formatting. Placeholders without an
+// argument and text from an unmatched brace on are written as they are.
+template<typename OutIt, typename Char, typename... Args>
+inline OutIt vformat_to(OutIt out, std::basic_string_view<Char> fmt, const Args &...args) {
+  auto index = std::size_t{};
+  for (auto pos = std::size_t{}; pos < fmt.size();) {
+    auto piece = fmt_piece{};
+    auto next = next_piece(fmt, pos, piece);
+    if (next == std::string_view::npos) return write_str(out, fmt.substr(pos));
+    auto first = fmt.data() + piece.first;
+    if (!piece.placeholder) {
+      out = write_str(out, first, first + piece.size);
+    } else if constexpr (sizeof...(Args) != 0) {
+      if (index < sizeof...(Args)) {
+        out = format_nth(out, index++, first, first + piece.size, args...);
+      } else {
+        out = write_str(out, fmt.substr(pos, next - pos));
+      }
+    } else {
+      out = write_str(out, fmt.substr(pos, next - pos));
+    }
+    pos = next;
+  }
+  return out;
+}
+
+template<typename Fmt, std::size_t I, typename OutIt, typename Tuple>
+inline OutIt format_piece(OutIt out, const Tuple &args) {
+  constexpr auto piece = Fmt::pieces[I];
+  constexpr auto text = Fmt::str.substr(piece.first, piece.size);
+  if constexpr (!piece.placeholder) {
+    return write_str(out, text);
+  } else {
+    using arg_type = remove_cr_t<std::tuple_element_t<piece.index, Tuple>>;
+    return formatter<arg_type>()(std::get<piece.index>(args), out, text.data(), text.data() + text.size());
+  }
+}
+
+template<typename Fmt, typename OutIt, typename Tuple, std::size_t... I>
+inline OutIt format_pieces(OutIt out, const Tuple &args, std::index_sequence<I...>) {
+  (..., (out = format_piece<Fmt, I>(out, args)));
+  return out;
+}
+
+template<typename OutIt, typename Str, typename... Args>
+inline OutIt vformat_to(OutIt out, fmt<Str>, const Args &...args) {
+  using fmt_type = fmt<Str>;
+  static_assert(fmt_type::args == sizeof...(Args), "whl::format: argument count does not match the format string");
+  return format_pieces<fmt_type>(out, std::forward_as_tuple(args...), std::make_index_sequence<fmt_type::pieces.size()>());
+}
+
+// Format strings are compile-time `fmt`s, or anything viewable as a string.
+template<typename Fmt>
+inline auto fmt_view(const Fmt &fmt) {
+  if constexpr (is_fmt<Fmt>::value) {
+    return fmt;
+  } else if constexpr (std::is_convertible_v<const Fmt &, std::string_view>) {
+    return std::string_view(fmt);
+  } else if constexpr (std::is_convertible_v<const Fmt &, std::wstring_view>) {
+    return std::wstring_view(fmt);
+  } else {
+    using char_type = remove_cr_t<decltype(*std::begin(fmt))>;
+    return std::basic_string_view<char_type>(std::data(fmt), std::size(fmt));
+  }
+}
+
+template<typename Fmt>
+struct fmt_char {
+  using type = typename decltype(fmt_view(std::declval<const Fmt &>()))::value_type;
+};
+
+template<typename Str>
+struct fmt_char<fmt<Str>> {
+  using type = char;
+};
+
+template<typename Fmt>
+using fmt_char_t = typename fmt_char<Fmt>::type;
+
+// Parsed `[[fill]align][sign][#][0][width][.precision][type]`, the part of a
+// placeholder after its colon.
+template<typename Char>
+struct format_spec {
+  Char fill = ' ';
+  char align = 0, sign = '-', type = 0;
+  bool alt = false, zero = false;
+  std::size_t width = 0;
+  int precision = -1;
+};
+
+template<typename Char>
+constexpr bool is_digit(Char ch) {
+  return ch >= '0' && ch <= '9';
+}
+
+template<typename Char>
+constexpr format_spec<Char> parse_spec(const Char *first, const Char *last) {
+  auto spec = format_spec<Char>{};
+  while (first != last && *first != ':') ++first;
+  if (first == last) return spec;
+  ++first;
+  auto is_align = [](Char ch) { return ch == '<' || ch == '>' || ch == '^'; };
+  if (last - first >= 2 && is_align(first[1])) {
+    spec.fill = first[0];
+    spec.align = static_cast<char>(first[1]);
+    first += 2;
+  } else if (first != last && is_align(*first)) {
+    spec.align = static_cast<char>(*first++);
+  }
+  if (first != last && (*first == '+' || *first == '-' || *first == ' ')) spec.sign = static_cast<char>(*first++);
+  if (first != last && *first == '#') {
+    spec.alt = true;
+    ++first;
+  }
+  if (first != last && *first == '0') {
+    spec.zero = true;
+    ++first;
+  }
+  for (; first != last && is_digit(*first); ++first) {
+    spec.width = spec.width * 10 + static_cast<std::size_t>(*first - '0');
+  }
+  if (first != last && *first == '.') {
+    spec.precision = 0;
+    for (++first; first != last && is_digit(*first); ++first) {
+      spec.precision = spec.precision * 10 + static_cast<int>(*first - '0');
+    }
+  }
+  if (first != last) spec.type = static_cast<char>(*first);
+  return spec;
+}
+
+// "00" to "99", so that decimal digits are produced two at a time.
+struct digit_pairs {
+  char pairs[200]{};
+
+  constexpr digit_pairs() {
+    for (auto i = 0; i < 100; ++i) {
+      pairs[i * 2] = static_cast<char>('0' + i / 10);
+      pairs[i * 2 + 1] = static_cast<char>('0' + i % 10);
+    }
+  }
+};
+
+inline constexpr auto digits = digit_pairs{};
+
+// Writes the digits of `value` backwards from `last`, returns the first.
+template<typename UInt>
+constexpr char *write_decimal(char *last, UInt value) {
+  while (value >= 100) {
+    auto i = static_cast<std::size_t>(value % 100) * 2;
+    value /= 100;
+    *--last = digits.pairs[i + 1];
+    *--last = digits.pairs[i];
+  }
+  if (value >= 10) {
+    auto i = static_cast<std::size_t>(value) * 2;
+    *--last = digits.pairs[i + 1];
+    *--last = digits.pairs[i];
+  } else {
+    *--last = static_cast<char>('0' + value);
+  }
+  return last;
+}
+
+// Numbers are right aligned by default; `0` pads between sign and digits.
+template<typename OutIt, typename Char>
+inline OutIt write_padded(OutIt out, const format_spec<Char> &spec, std::string_view prefix, std::string_view body) {
+  auto size = prefix.size() + body.size();
+  auto pad = spec.width > size ? spec.width - size : 0;
+  if (spec.align == 0 && spec.zero) {
+    out = write_str(out, prefix);
+    out = std::fill_n(out, pad, static_cast<Char>('0'));
+    return write_str(out, body);
+  }
+  auto before = spec.align == '<' ? 0 : spec.align == '^' ? pad / 2 : pad;
+  out = std::fill_n(out, before, spec.fill);
+  out = write_str(out, prefix);
+  out = write_str(out, body);
+  return std::fill_n(out, pad - before, spec.fill);
+}
+
+template<typename Int>
+constexpr auto unsigned_abs(Int value) {
+  using uint_type = std::make_unsigned_t<Int>;
+  auto abs = static_cast<uint_type>(value);
+  if constexpr (std::is_signed_v<Int>) {
+    if (value < 0) abs = static_cast<uint_type>(uint_type{0} - abs);
+  }
+  return abs;
+}
+
+template<typename Int>
+constexpr bool is_negative(Int value) {
+  if constexpr (std::is_signed_v<Int>) {
+    return value < 0;
   } else {
-    std::for_each(end + 1, last, [&out](auto &&it) { out << it; });
+    return false;
   }
 }
 
-template<typename Out, typename FmtIter, typename... Args>
-inline void format_to(Out &out, FmtIter first, FmtIter last, const Args &...args) {
-  if constexpr (sizeof...(args) == 0) {
-    std::for_each(first, last, [&out](auto &&it) { out << it; });
+template<typename OutIt, typename Int>
+inline OutIt write_int(OutIt out, Int value) {
+  char buf[std::numeric_limits<Int>::digits10 + 3];
+  auto last = buf + sizeof(buf);
+  auto first = write_decimal(last, unsigned_abs(value));
+  if (is_negative(value)) *--first = '-';
+  return write_str(out, first, last);
+}
+
+template<typename OutIt, typename Int, typename Char>
+inline OutIt write_int(OutIt out, Int value, const format_spec<Char> &spec) {
+  char buf[std::numeric_limits<Int>::digits + 2];
+  char prefix[3]{};
+  auto prefix_size = std::size_t{};
+  if (is_negative(value)) {
+    prefix[prefix_size++] = '-';
+  } else if (spec.sign != '-') {
+    prefix[prefix_size++] = spec.sign;
+  }
+  auto abs = unsigned_abs(value);
+  auto first = buf, last = buf + sizeof(buf);
+  auto base = spec.type == 'x' || spec.type == 'X' ? 16 : spec.type == 'o' ? 8 : spec.type == 'b' || spec.type == 'B' ? 2 : 10;
+  if (base == 10) {
+    first = write_decimal(last, abs);
   } else {
-    format_to(out, first, last, args...);
+    last = std::to_chars(buf, last, abs, base).ptr;
+    if (spec.type == 'X') std::transform(first, last, first, [](char ch) { return ch >= 'a' ? static_cast<char>(ch - 'a' + 'A') : ch; });
+    if (spec.alt && base != 8) {
+      prefix[prefix_size++] = '0';
+      prefix[prefix_size++] = spec.type;
+    } else if (spec.alt && abs != 0) {
+      prefix[prefix_size++] = '0';
+    }
   }
+  return write_padded(out, spec, {prefix, prefix_size}, {first, static_cast<std::size_t>(last - first)});
 }
 
-template<typename FmtIter, typename... Args>
-inline auto format(FmtIter first, FmtIter last, const Args &...args) {
-  using char_type = remove_cr_t<decltype(*first)>;
-  std::basic_ostringstream<char_type> out{};
-  format_to(out, first, last, args...);
-  return out.str();
+// Shortest round trip by default; `e`, `f`, `g` with a precision (6 if not
+// given) and `a` as in `std::to_chars`, upper case for `E`, `F`, `G`, `A`.
+template<typename OutIt, typename Float, typename Char>
+inline OutIt write_float(OutIt out, Float value, const format_spec<Char> &spec) {
+  auto sign = std::signbit(value) ? '-' : spec.sign != '-' ? spec.sign : '\0';
+  value = std::abs(value);
+  auto type = static_cast<char>(spec.type | 0x20);
+  auto buffer = basic_memory_buffer<char, 128>{};
+  buffer.resize(buffer.capacity());
+  for (;;) {
+    auto first = buffer.data(), last = first + buffer.size();
+    auto result = std::to_chars_result{};
+    if (type == 'e' || type == 'f' || type == 'g') {
+      auto format = type == 'e' ? std::chars_format::scientific : type == 'f' ? std::chars_format::fixed : std::chars_format::general;
+      result = std::to_chars(first, last, value, format, spec.precision < 0 ? 6 : spec.precision);
+    } else if (type == 'a') {
+      result = spec.precision < 0 ? std::to_chars(first, last, value, std::chars_format::hex) : std::to_chars(first, last, value, std::chars_format::hex, spec.precision);
+    } else if (spec.precision >= 0) {
+      result = std::to_chars(first, last, value, std::chars_format::general, spec.precision);
+    } else {
+      result = std::to_chars(first, last, value);
+    }
+    if (result.ec == std::errc{}) {
+      last = result.ptr;
+      if (spec.type >= 'A' && spec.type <= 'Z') std::transform(first, last, first, [](char ch) { return ch >= 'a' ? static_cast<char>(ch - 'a' + 'A') : ch; });
+      auto finite_spec = spec;
+      finite_spec.zero = spec.zero && std::isfinite(value);
+      return write_padded(out, finite_spec, {&sign, sign ? 1u : 0u}, {first, static_cast<std::size_t>(last - first)});
+    }
+    buffer.resize(buffer.size() * 2);
+  }
 }
 
-template<typename Out, typename... Args>
-inline void out_to(Out &out, const Args &...args) {
-  (..., (formatter<Args>()(args, out, nullptr, nullptr)));
+template<typename OutIt, typename Float>
+inline OutIt write_float(OutIt out, Float value) {
+  char buf[64];
+  return write_str(out, buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
 }
 
-template<typename Out, typename Tuple, std::size_t... I>
-inline void out_tuple_to(Out &out, const Tuple &tuple, std::index_sequence<I...>) {
-  out << '(';
-  (..., out_to(out, I ? ", " : "", std::get<I>(tuple)));
-  out << ')';
+template<typename T>
+struct is_format_int : std::bool_constant<std::is_integral_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char> && !std::is_same_v<T, wchar_t> && !std::is_same_v<T, char16_t> && !std::is_same_v<T, char32_t>> {};
+
+struct string_formatter {
+
+  template<typename Str, typename OutIt, typename FmtIter>
+  OutIt operator()(const Str &arg, OutIt out, FmtIter first, FmtIter last) {
+    return write_str(out, arg.data(), arg.data() + arg.size());
+  }
+};
+
+template<typename Char, typename Tuple, std::size_t... I>
+inline auto write_tuple(Char out, const Tuple &tuple, std::index_sequence<I...>) {
+  out = write_args(out, '(');
+  (..., (out = write_args(out, I ? ", " : "", std::get<I>(tuple))));
+  return write_args(out, ')');
 }
 
 } // namespace detail
 
+template<typename OutIt, typename Fmt, typename... Args>
+inline OutIt format_to(OutIt out, const Fmt &fmt, const Args &...args) {
+  return detail::vformat_to(out, detail::fmt_view(fmt), args...);
+}
+
+template<typename Char, std::size_t N, typename Fmt, typename... Args>
+inline auto format_to(basic_memory_buffer<Char, N> &buffer, const Fmt &fmt, const Args &...args) {
+  return detail::vformat_to(detail::buffer_appender<basic_memory_buffer<Char, N>>{&buffer}, detail::fmt_view(fmt), args...);
+}
+
+// Writes at most `n` characters, and returns the iterator past them along
+// with the untruncated size.
+template<typename OutIt, typename Fmt, typename... Args>
+inline auto format_to_n(OutIt out, std::size_t n, const Fmt &fmt, const Args &...args) {
+  auto it = detail::truncating_iterator<OutIt, detail::fmt_char_t<Fmt>>{out, n, 0};
+  it = detail::vformat_to(it, detail::fmt_view(fmt), args...);
+  return format_to_n_result<OutIt>{it.out, it.count};
+}
+
+template<typename Fmt, typename... Args>
+inline std::size_t formatted_size(const Fmt &fmt, const Args &...args) {
+  return detail::vformat_to(detail::counting_iterator<detail::fmt_char_t<Fmt>>{0}, detail::fmt_view(fmt), args...).count;
+}
+
 template<typename Fmt, typename... Args>
 inline auto format(const Fmt &fmt, const Args &...args) {
-  return detail::format(std::begin(fmt), std::end(fmt), args...);
+  auto buffer = basic_memory_buffer<detail::fmt_char_t<Fmt>>{};
+  format_to(buffer, fmt, args...);
+  return buffer.str();
 }
 
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+// `whl::format<"{} + {}">(a, b)`, checked and split at compile time.
+template<fixed_string S, typename... Args>
+inline auto format(const Args &...args) {
+  return format(fmt<fixed_str<S>>{}, args...);
+}
+#endif
+
 template<typename Char = char, typename... Args>
 inline auto to_string(const Args &...args) {
-  auto out = std::basic_ostringstream<Char>{};
-  detail::out_to(out, args...);
-  return out.str();
+  auto buffer = basic_memory_buffer<Char>{};
+  detail::out_to(buffer, args...);
+  return buffer.str();
 }
 
-template<>
-struct formatter<std::string> {
+template<typename T, typename Enable>
+template<typename OutIt, typename FmtIter>
+OutIt formatter<T, Enable>::operator()(const T &arg, OutIt out, FmtIter first, FmtIter last) {
+  auto stream = std::basic_ostringstream<detail::out_char_t<OutIt>>{};
+  stream << arg;
+  return detail::write_str(out, std::basic_string_view<detail::out_char_t<OutIt>>(stream.str()));
+}
+
+template<typename Char>
+struct formatter<Char, std::enable_if_t<std::is_same_v<Char, char> || std::is_same_v<Char, wchar_t>>> {
 
-  template<typename Out, typename FmtIter>
-  void operator()(const std::string &arg, Out &out, FmtIter first, FmtIter last) {
-    out << arg;
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(Char arg, OutIt out, FmtIter first, FmtIter last) {
+    *out++ = arg;
+    return out;
   }
 };
 
 template<>
-struct formatter<std::wstring> {
+struct formatter<std::string> : detail::string_formatter {};
 
-  template<typename Out, typename FmtIter>
-  void operator()(const std::wstring &arg, Out &out, FmtIter first, FmtIter last) {
-    out << arg;
-  }
-};
+template<>
+struct formatter<std::wstring> : detail::string_formatter {};
+
+template<>
+struct formatter<std::string_view> : detail::string_formatter {};
 
 template<>
-struct formatter<const char *> {
+struct formatter<std::wstring_view> : detail::string_formatter {};
 
-  template<typename Out, typename FmtIter>
-  void operator()(const char *arg, Out &out, FmtIter first, FmtIter last) {
-    out << arg;
+template<typename Char>
+struct formatter<const Char *, std::enable_if_t<std::is_same_v<Char, char> || std::is_same_v<Char, wchar_t>>> {
+
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(const Char *arg, OutIt out, FmtIter first, FmtIter last) {
+    return detail::write_str(out, std::basic_string_view<Char>(arg));
   }
 };
 
-template<>
-struct formatter<const wchar_t *> {
+template<typename Char>
+struct formatter<Char *, std::enable_if_t<std::is_same_v<Char, char> || std::is_same_v<Char, wchar_t>>> : formatter<const Char *> {};
 
-  template<typename Out, typename FmtIter>
-  void operator()(const wchar_t *arg, Out &out, FmtIter first, FmtIter last) {
-    out << arg;
+// String literals and other character arrays, up to their terminator.
+template<typename Char, std::size_t N>
+struct formatter<Char[N], std::enable_if_t<std::is_same_v<Char, char> || std::is_same_v<Char, wchar_t>>> {
+
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(const Char (&arg)[N], OutIt out, FmtIter first, FmtIter last) {
+    return detail::write_str(out, arg, std::find(arg, arg + N, Char{}));
   }
 };
 
 template<>
 struct formatter<bool> {
 
-  template<typename Out, typename FmtIter>
-  void operator()(bool arg, Out &out, FmtIter first, FmtIter last) {
-    out << (arg ? "true" : "false");
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(bool arg, OutIt out, FmtIter first, FmtIter last) {
+    return detail::write_args(out, arg ? "true" : "false");
+  }
+};
+
+// Integers other than characters and bool, written without iostreams.
+template<typename T>
+struct formatter<T, std::enable_if_t<detail::is_format_int<T>::value>> {
+
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(T arg, OutIt out, FmtIter first, FmtIter last) {
+    if (first == last) return detail::write_int(out, arg);
+    return detail::write_int(out, arg, detail::parse_spec(first, last));
+  }
+};
+
+template<typename T>
+struct formatter<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(T arg, OutIt out, FmtIter first, FmtIter last) {
+    if (first == last) return detail::write_float(out, arg);
+    return detail::write_float(out, arg, detail::parse_spec(first, last));
   }
 };
 
 template<typename T1, typename T2>
 struct formatter<std::pair<T1, T2>> {
 
-  template<typename Out, typename FmtIter>
-  void operator()(const std::pair<T1, T2> &pair, Out &out, FmtIter first, FmtIter last) {
-    detail::out_to(out, '(', pair.first, ", ", pair.second, ')');
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(const std::pair<T1, T2> &pair, OutIt out, FmtIter first, FmtIter last) {
+    return detail::write_args(out, '(', pair.first, ", ", pair.second, ')');
   }
 };
 
 template<typename... Args>
 struct formatter<std::tuple<Args...>> {
 
-  template<typename Out, typename FmtIter>
-  void operator()(const std::tuple<Args...> &tuple, Out &out, FmtIter first, FmtIter last) {
-    detail::out_tuple_to(out, tuple, std::make_index_sequence<sizeof...(Args)>());
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(const std::tuple<Args...> &tuple, OutIt out, FmtIter first, FmtIter last) {
+    return detail::write_tuple(out, tuple, std::make_index_sequence<sizeof...(Args)>());
   }
 };
 
 template<typename T>
 struct formatter<T, decltype(std::begin(std::declval<T>()), void())> {
 
-  template<typename Out, typename FmtIter>
-  void operator()(const T &arg, Out &out, FmtIter first, FmtIter last) {
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(const T &arg, OutIt out, FmtIter first, FmtIter last) {
     auto it = std::begin(arg);
-    if (it == std::end(arg)) {
-      out << "[]";
-      return;
-    }
-    detail::out_to(out, '[', *it++);
+    if (it == std::end(arg)) return detail::write_args(out, "[]");
+    out = detail::write_args(out, '[', *it++);
     for (; it != std::end(arg); ++it) {
-      detail::out_to(out, ", ", *it);
+      out = detail::write_args(out, ", ", *it);
     }
-    out << ']';
+    return detail::write_args(out, ']');
   }
 };
 
@@ -76,34 +76,45 @@ constexpr inline auto supply(Val val) {
   return [val]() { return val; };
 }
 
+// `x <Op> value`, as a named type so that stages can recognize the comparison.
+template<typename Op, typename Val>
+struct bound_compare {
+  Val value;
+
+  template<typename T>
+  constexpr bool operator()(const T &x) const {
+    return Op{}(x, value);
+  }
+};
+
 template<typename Val>
 constexpr inline auto equal_with(Val val) {
-  return [val](auto &&x) { return x == val; };
+  return bound_compare<std::equal_to<>, Val>{val};
 }
 
 template<typename Val>
 constexpr inline auto not_equal_with(Val val) {
-  return [val](auto &&x) { return x != val; };
+  return bound_compare<std::not_equal_to<>, Val>{val};
 }
 
 template<typename Val>
 constexpr inline auto great_than(Val val) {
-  return [val](auto &&x) { return x > val; };
+  return bound_compare<std::greater<>, Val>{val};
 }
 
 template<typename Val>
 constexpr inline auto less_than(Val val) {
-  return [val](auto &&x) { return x < val; };
+  return bound_compare<std::less<>, Val>{val};
 }
 
 template<typename Val>
 constexpr inline auto great_equal_than(Val val) {
-  return [val](auto &&x) { return x >= val; };
+  return bound_compare<std::greater_equal<>, Val>{val};
 }
 
 template<typename Val>
 constexpr inline auto less_equal_than(Val val) {
-  return [val](auto &&x) { return x <= val; };
+  return bound_compare<std::less_equal<>, Val>{val};
 }
 
 } // namespace whl::func
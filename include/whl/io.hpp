@@ -0,0 +1,387 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_IO_HPP
+#define WHEEL_WHL_IO_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WHL_IO_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // defined(__unix__) || defined(__APPLE__)
+
+#include "whl/sequence.hpp"
+#include "whl/simd.hpp"
+
+namespace whl::io {
+
+namespace detail {
+
+[[noreturn]] inline void throw_errno(const std::filesystem::path &path) {
+  throw std::system_error(errno, std::generic_category(), path.string());
+}
+
+struct file_handle {
+  private:
+#ifdef WHL_IO_POSIX
+  int fd;
+#else
+  std::FILE *file;
+#endif
+
+  public:
+  explicit file_handle(const std::filesystem::path &path) {
+#ifdef WHL_IO_POSIX
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw_errno(path);
+#else
+    file = std::fopen(path.string().c_str(), "rb");
+    if (!file) throw_errno(path);
+#endif
+  }
+
+  file_handle(const file_handle &) = delete;
+
+  ~file_handle() {
+#ifdef WHL_IO_POSIX
+    ::close(fd);
+#else
+    std::fclose(file);
+#endif
+  }
+
+  // Size of a regular file, or -1 for pipes, sockets and devices.
+  std::ptrdiff_t regular_size() const noexcept {
+#ifdef WHL_IO_POSIX
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+    return static_cast<std::ptrdiff_t>(st.st_size);
+#else
+    return -1;
+#endif
+  }
+
+  std::size_t read_some(char *buf, std::size_t n) {
+#ifdef WHL_IO_POSIX
+    for (;;) {
+      auto got = ::read(fd, buf, n);
+      if (got >= 0) return static_cast<std::size_t>(got);
+      if (errno != EINTR) throw std::system_error(errno, std::generic_category(), "read");
+    }
+#else
+    return std::fread(buf, 1, n, file);
+#endif
+  }
+
+#ifdef WHL_IO_POSIX
+  int native() const noexcept {
+    return fd;
+  }
+#endif
+};
+
+} // namespace detail
+
+// Read-only view of a whole file. Regular files are mapped with a sequential
+// access hint, anything else (pipes, devices) is read into memory.
+struct mapped_file {
+  private:
+  const char *data_{};
+  std::size_t size_{};
+  bool mapped_{};
+  std::unique_ptr<char[]> owned{};
+
+  public:
+  mapped_file() = default;
+
+  explicit mapped_file(const std::filesystem::path &path) {
+    auto file = detail::file_handle{path};
+    auto size = file.regular_size();
+#ifdef WHL_IO_POSIX
+    if (size == 0) return;
+    if (size > 0) {
+      auto addr = ::mmap(nullptr, static_cast<std::size_t>(size), PROT_READ, MAP_PRIVATE, file.native(), 0);
+      if (addr == MAP_FAILED) detail::throw_errno(path);
+      ::madvise(addr, static_cast<std::size_t>(size), MADV_SEQUENTIAL);
+      data_ = static_cast<const char *>(addr);
+      size_ = static_cast<std::size_t>(size);
+      mapped_ = true;
+      return;
+    }
+#endif
+    auto capacity = std::size_t{1} << 16;
+    owned.reset(new char[capacity]);
+    for (;;) {
+      if (size_ == capacity) {
+        auto grown = std::unique_ptr<char[]>{new char[capacity * 2]};
+        std::memcpy(grown.get(), owned.get(), size_);
+        owned = std::move(grown);
+        capacity *= 2;
+      }
+      auto got = file.read_some(owned.get() + size_, capacity - size_);
+      if (got == 0) break;
+      size_ += got;
+    }
+    data_ = owned.get();
+  }
+
+  mapped_file(const mapped_file &) = delete;
+
+  mapped_file(mapped_file &&file) noexcept
+      : data_(file.data_), size_(file.size_), mapped_(file.mapped_), owned(std::move(file.owned)) {
+    file.data_ = nullptr;
+    file.size_ = 0;
+    file.mapped_ = false;
+  }
+
+  ~mapped_file() {
+#ifdef WHL_IO_POSIX
+    if (mapped_) ::munmap(const_cast<char *>(data_), size_);
+#endif
+  }
+
+  mapped_file &operator=(mapped_file &&file) noexcept {
+    mapped_file(std::move(file)).swap(*this);
+    return *this;
+  }
+
+  void swap(mapped_file &file) noexcept {
+    std::swap(data_, file.data_);
+    std::swap(size_, file.size_);
+    std::swap(mapped_, file.mapped_);
+    std::swap(owned, file.owned);
+  }
+
+  const char *data() const noexcept {
+    return data_;
+  }
+
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  bool mapped() const noexcept {
+    return mapped_;
+  }
+
+  const char *begin() const noexcept {
+    return data_;
+  }
+
+  const char *end() const noexcept {
+    return data_ + size_;
+  }
+};
+
+namespace detail {
+
+struct line_source {
+  // In-memory mode: lines are views of [first, last) inside `file`.
+  std::shared_ptr<const mapped_file> file;
+  const char *first{}, *last{};
+
+  // Streaming mode: lines are views of `buffer`, valid until the next read.
+  std::unique_ptr<file_handle> handle;
+  std::unique_ptr<char[]> buffer;
+  std::size_t capacity{}, head{}, tail{}, consumed{};
+  bool eof{};
+
+  line_source(std::shared_ptr<const mapped_file> file, const char *first, const char *last)
+      : file(std::move(file)), first(first), last(last) {}
+
+  explicit line_source(std::unique_ptr<file_handle> handle)
+      : handle(std::move(handle)), buffer(new char[std::size_t{1} << 16]), capacity(std::size_t{1} << 16) {}
+
+  bool streaming() const noexcept {
+    return handle != nullptr;
+  }
+
+  bool read_line(std::size_t &offset, std::string_view &line) {
+    auto scan = head;
+    for (;;) {
+      auto begin = buffer.get() + scan;
+      auto nl = simd::find(begin, buffer.get() + tail, '\n');
+      if (nl != buffer.get() + tail) {
+        offset = consumed;
+        line = std::string_view(buffer.get() + head, static_cast<std::size_t>(nl - buffer.get()) - head);
+        consumed += line.size() + 1;
+        head = static_cast<std::size_t>(nl - buffer.get()) + 1;
+        return true;
+      }
+      if (eof) {
+        if (head == tail) return false;
+        offset = consumed;
+        line = std::string_view(buffer.get() + head, tail - head);
+        consumed += line.size();
+        head = tail;
+        return true;
+      }
+      scan = tail - head;
+      if (head != 0) {
+        std::memmove(buffer.get(), buffer.get() + head, tail - head);
+        tail -= head;
+        head = 0;
+      }
+      if (tail == capacity) {
+        auto grown = std::unique_ptr<char[]>{new char[capacity * 2]};
+        std::memcpy(grown.get(), buffer.get(), tail);
+        buffer = std::move(grown);
+        capacity *= 2;
+      }
+      auto got = handle->read_some(buffer.get() + tail, capacity - tail);
+      tail += got;
+      eof = got == 0;
+    }
+  }
+};
+
+} // namespace detail
+
+struct line_iter {
+  public:
+  using value_type = std::string_view;
+  using pointer = const std::string_view *;
+  using reference = const std::string_view &;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+
+  private:
+  static constexpr auto npos = static_cast<std::size_t>(-1);
+
+  std::shared_ptr<detail::line_source> source{};
+  std::string_view line{};
+  std::size_t offset{npos};
+
+  void find_line(const char *begin) {
+    if (begin >= source->last) {
+      offset = npos;
+      return;
+    }
+    auto nl = simd::find(begin, source->last, '\n');
+    offset = static_cast<std::size_t>(begin - source->first);
+    line = std::string_view(begin, static_cast<std::size_t>(nl - begin));
+  }
+
+  public:
+  line_iter() = default;
+
+  explicit line_iter(std::shared_ptr<detail::line_source> src) : source(std::move(src)) {
+    if (source->streaming()) {
+      if (!source->read_line(offset, line)) offset = npos;
+    } else {
+      find_line(source->first);
+    }
+  }
+
+  value_type operator*() const {
+    return line;
+  }
+
+  pointer operator->() const {
+    return &line;
+  }
+
+  line_iter &operator++() {
+    if (source->streaming()) {
+      if (!source->read_line(offset, line)) offset = npos;
+    } else {
+      auto end = line.data() + line.size();
+      if (end == source->last) {
+        offset = npos;
+      } else {
+        find_line(end + 1);
+      }
+    }
+    return *this;
+  }
+
+  line_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator!=(const line_iter &it) const {
+    return !(*this == it);
+  }
+
+  bool operator==(const line_iter &it) const {
+    return offset == it.offset;
+  }
+};
+
+// Lines of the file at `path` without their '\n', as string_views into the
+// mapping, which stays alive as long as any iterator of the sequence. Pipes
+// and other unmappable files are streamed instead, in which case each line is
+// only valid until the iterator is advanced.
+inline auto lines(const std::filesystem::path &path) {
+  auto handle = std::make_unique<detail::file_handle>(path);
+  if (handle->regular_size() < 0) {
+    return sequence{line_iter{std::make_shared<detail::line_source>(std::move(handle))}, line_iter{}};
+  }
+  handle.reset();
+  auto file = std::make_shared<const mapped_file>(path);
+  auto first = file->begin(), last = file->end();
+  return sequence{line_iter{std::make_shared<detail::line_source>(std::move(file), first, last)}, line_iter{}};
+}
+
+// Splits the file at `path` into at most `n` line sequences of roughly equal
+// byte size, each one starting and ending on a line boundary, so that they
+// can be processed independently.
+inline auto line_chunks(const std::filesystem::path &path, std::size_t n) {
+  auto file = std::make_shared<const mapped_file>(path);
+  auto chunks = std::vector<sequence<line_iter>>{};
+  auto first = file->begin(), last = file->end();
+  for (std::size_t i = 1; i <= n && first != last; ++i) {
+    auto end = last;
+    if (i != n) {
+      auto target = file->begin() + file->size() / n * i;
+      if (target < first) target = first;
+      end = simd::find(target, last, '\n');
+      if (end != last) ++end;
+    }
+    auto source = std::make_shared<detail::line_source>(file, first, end);
+    chunks.push_back(sequence{line_iter{std::move(source)}, line_iter{}});
+    first = end;
+  }
+  return chunks;
+}
+
+} // namespace whl::io
+
+#endif // WHEEL_WHL_IO_HPP
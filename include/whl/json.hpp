@@ -0,0 +1,304 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_JSON_HPP
+#define WHEEL_WHL_JSON_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "whl/format.hpp"
+#include "whl/simd.hpp"
+#include "whl/type.hpp"
+
+namespace whl {
+
+// Customization point: `operator()(value, out)` writes `value` as JSON to the
+// output iterator `out` and returns the advanced iterator.
+template<typename T, typename = void>
+struct json_formatter;
+
+// A named member of a user type. Types get serialized as objects when an
+// ADL-visible `json_fields(const T &)` returns a tuple of these:
+//
+//   auto json_fields(const point &p) {
+//     return std::tuple{whl::json_field{"x", p.x}, whl::json_field{"y", p.y}};
+//   }
+template<typename T>
+struct json_field {
+  std::string_view name;
+  const T &value;
+};
+
+template<typename T>
+json_field(std::string_view, const T &) -> json_field<T>;
+
+namespace detail {
+
+template<typename T>
+inline constexpr bool is_json_string = std::is_convertible_v<const T &, std::string_view>;
+
+template<typename T, typename = void>
+struct is_json_map : std::false_type {};
+
+template<typename T>
+struct is_json_map<T, std::void_t<typename T::key_type, typename T::mapped_type>>
+    : std::bool_constant<is_json_string<typename T::key_type> || std::is_arithmetic_v<typename T::key_type>> {};
+
+template<typename T, typename = void>
+struct has_json_fields : std::false_type {};
+
+template<typename T>
+struct has_json_fields<T, decltype(json_fields(std::declval<const T &>()), void())> : std::true_type {};
+
+template<typename T>
+inline constexpr bool is_json_array = is_iterable_v<const T> && !is_json_string<T> && !is_json_map<T>::value && !has_json_fields<T>::value;
+
+template<typename OutIt>
+inline OutIt write_json_escape(OutIt out, char ch) {
+  switch (ch) {
+    case '"': return write_str(out, std::string_view("\\\""));
+    case '\\': return write_str(out, std::string_view("\\\\"));
+    case '\b': return write_str(out, std::string_view("\\b"));
+    case '\f': return write_str(out, std::string_view("\\f"));
+    case '\n': return write_str(out, std::string_view("\\n"));
+    case '\r': return write_str(out, std::string_view("\\r"));
+    case '\t': return write_str(out, std::string_view("\\t"));
+    default: {
+      constexpr auto hex = std::string_view("0123456789abcdef");
+      char code[] = {'\\', 'u', '0', '0', hex[(ch >> 4) & 0xf], hex[ch & 0xf]};
+      return write_str(out, code, code + sizeof(code));
+    }
+  }
+}
+
+// Runs without special characters are found 16 bytes at a time and copied
+// in one go.
+template<typename OutIt>
+inline OutIt write_json_string(OutIt out, std::string_view str) {
+  *out++ = '"';
+  auto first = str.data(), last = str.data() + str.size();
+  for (;;) {
+    auto special = simd::find_json_escape(first, last);
+    out = write_str(out, first, special);
+    if (special == last) break;
+    out = write_json_escape(out, *special);
+    first = special + 1;
+  }
+  *out++ = '"';
+  return out;
+}
+
+template<typename OutIt, typename T>
+inline OutIt write_json_value(OutIt out, const T &value) {
+  return json_formatter<T>()(value, out);
+}
+
+template<typename OutIt, typename T>
+inline OutIt write_json_key(OutIt out, const T &key) {
+  if constexpr (is_json_string<T>) {
+    out = write_json_string(out, key);
+  } else if constexpr (std::is_same_v<T, char>) {
+    out = write_json_string(out, std::string_view(&key, 1));
+  } else {
+    *out++ = '"';
+    out = write_json_value(out, key);
+    *out++ = '"';
+  }
+  *out++ = ':';
+  return out;
+}
+
+template<typename OutIt, typename Tuple, std::size_t... I>
+inline OutIt write_json_tuple(OutIt out, const Tuple &tuple, std::index_sequence<I...>) {
+  *out++ = '[';
+  (..., (out = write_json_value(I ? write_str(out, std::string_view(",")) : out, std::get<I>(tuple))));
+  *out++ = ']';
+  return out;
+}
+
+template<typename OutIt, typename Tuple, std::size_t... I>
+inline OutIt write_json_fields(OutIt out, const Tuple &fields, std::index_sequence<I...>) {
+  *out++ = '{';
+  (..., (out = write_json_value(write_json_key(I ? write_str(out, std::string_view(",")) : out, std::get<I>(fields).name), std::get<I>(fields).value)));
+  *out++ = '}';
+  return out;
+}
+
+} // namespace detail
+
+template<>
+struct json_formatter<bool> {
+
+  template<typename OutIt>
+  OutIt operator()(bool value, OutIt out) {
+    return detail::write_str(out, std::string_view(value ? "true" : "false"));
+  }
+};
+
+template<>
+struct json_formatter<std::nullptr_t> {
+
+  template<typename OutIt>
+  OutIt operator()(std::nullptr_t, OutIt out) {
+    return detail::write_str(out, std::string_view("null"));
+  }
+};
+
+template<>
+struct json_formatter<std::nullopt_t> : json_formatter<std::nullptr_t> {};
+
+template<typename T>
+struct json_formatter<std::optional<T>> {
+
+  template<typename OutIt>
+  OutIt operator()(const std::optional<T> &value, OutIt out) {
+    return value ? detail::write_json_value(out, *value) : json_formatter<std::nullptr_t>()(nullptr, out);
+  }
+};
+
+template<typename T>
+struct json_formatter<T, std::enable_if_t<detail::is_format_int<T>::value>> {
+
+  template<typename OutIt>
+  OutIt operator()(T value, OutIt out) {
+    return detail::write_int(out, value);
+  }
+};
+
+// Infinities and NaN have no JSON representation and become null.
+template<typename T>
+struct json_formatter<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+
+  template<typename OutIt>
+  OutIt operator()(T value, OutIt out) {
+    if (!std::isfinite(value)) return json_formatter<std::nullptr_t>()(nullptr, out);
+    return detail::write_float(out, value);
+  }
+};
+
+template<>
+struct json_formatter<char> {
+
+  template<typename OutIt>
+  OutIt operator()(char value, OutIt out) {
+    return detail::write_json_string(out, std::string_view(&value, 1));
+  }
+};
+
+template<typename T>
+struct json_formatter<T, std::enable_if_t<detail::is_json_string<T>>> {
+
+  template<typename OutIt>
+  OutIt operator()(const T &value, OutIt out) {
+    return detail::write_json_string(out, std::string_view(value));
+  }
+};
+
+template<typename T1, typename T2>
+struct json_formatter<std::pair<T1, T2>> {
+
+  template<typename OutIt>
+  OutIt operator()(const std::pair<T1, T2> &value, OutIt out) {
+    return detail::write_json_tuple(out, value, std::index_sequence<0, 1>());
+  }
+};
+
+template<typename... Args>
+struct json_formatter<std::tuple<Args...>> {
+
+  template<typename OutIt>
+  OutIt operator()(const std::tuple<Args...> &value, OutIt out) {
+    return detail::write_json_tuple(out, value, std::index_sequence_for<Args...>());
+  }
+};
+
+template<typename T>
+struct json_formatter<T, std::enable_if_t<detail::is_json_array<T>>> {
+
+  template<typename OutIt>
+  OutIt operator()(const T &value, OutIt out) {
+    *out++ = '[';
+    auto first = true;
+    for (auto &&element : value) {
+      if (!first) *out++ = ',';
+      first = false;
+      out = detail::write_json_value(out, element);
+    }
+    *out++ = ']';
+    return out;
+  }
+};
+
+// Maps with string or number keys become objects.
+template<typename T>
+struct json_formatter<T, std::enable_if_t<detail::is_json_map<T>::value>> {
+
+  template<typename OutIt>
+  OutIt operator()(const T &value, OutIt out) {
+    *out++ = '{';
+    auto first = true;
+    for (auto &&[key, mapped] : value) {
+      if (!first) *out++ = ',';
+      first = false;
+      out = detail::write_json_value(detail::write_json_key(out, key), mapped);
+    }
+    *out++ = '}';
+    return out;
+  }
+};
+
+template<typename T>
+struct json_formatter<T, std::enable_if_t<detail::has_json_fields<T>::value>> {
+
+  template<typename OutIt>
+  OutIt operator()(const T &value, OutIt out) {
+    auto fields = json_fields(value);
+    return detail::write_json_fields(out, fields, std::make_index_sequence<std::tuple_size_v<decltype(fields)>>());
+  }
+};
+
+template<typename OutIt, typename T>
+inline OutIt write_json(OutIt out, const T &value) {
+  return detail::write_json_value(out, value);
+}
+
+template<typename Char, std::size_t N, typename T>
+inline void write_json(basic_memory_buffer<Char, N> &buffer, const T &value) {
+  detail::write_json_value(detail::buffer_appender<basic_memory_buffer<Char, N>>{&buffer}, value);
+}
+
+template<typename T>
+inline std::string to_json(const T &value) {
+  auto buffer = memory_buffer{};
+  write_json(buffer, value);
+  return buffer.str();
+}
+
+} // namespace whl
+
+#endif // WHEEL_WHL_JSON_HPP
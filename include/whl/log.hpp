@@ -0,0 +1,360 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_LOG_HPP
+#define WHEEL_WHL_LOG_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "whl/format.hpp"
+#include "whl/type.hpp"
+
+namespace whl {
+
+// What `log` does when the calling thread's ring is full.
+enum class log_policy {
+  drop,
+  block,
+};
+
+// Arguments of types for which this is true are copied as raw bytes and
+// formatted later on the logger's thread; specialize it for trivially
+// copyable types that hold no pointers. Other arguments are formatted on the
+// calling thread.
+template<typename T>
+struct log_by_value : std::bool_constant<std::is_arithmetic_v<T> || std::is_enum_v<T>> {};
+
+namespace detail {
+
+using log_decoder = void (*)(const char *, memory_buffer &);
+
+struct log_header {
+  std::size_t size;
+  log_decoder decode;
+};
+
+// Single producer, single consumer byte ring. Positions only grow; records
+// are whole multiples of the header size and never wrap, a header without a
+// decoder pads the end of the ring instead.
+struct log_ring {
+  alignas(64) std::atomic<std::size_t> head{0};
+  std::size_t cached_tail{0};
+  alignas(64) std::atomic<std::size_t> tail{0};
+  std::size_t capacity;
+  std::unique_ptr<char[]> data;
+
+  explicit log_ring(std::size_t capacity) : capacity(capacity), data(new char[capacity]) {}
+
+  // Space for a record of `size` bytes, or nullptr when the ring is full.
+  char *reserve(std::size_t size) noexcept {
+    auto pos = head.load(std::memory_order_relaxed);
+    auto offset = pos & (capacity - 1);
+    auto skip = offset + size > capacity ? capacity - offset : 0;
+    if (pos + skip + size - cached_tail > capacity) {
+      cached_tail = tail.load(std::memory_order_acquire);
+      if (pos + skip + size - cached_tail > capacity) return nullptr;
+    }
+    if (skip != 0) {
+      auto pad = log_header{skip, nullptr};
+      std::memcpy(data.get() + offset, &pad, sizeof(pad));
+      head.store(pos + skip, std::memory_order_release);
+      offset = 0;
+    }
+    return data.get() + offset;
+  }
+
+  void commit(std::size_t size) noexcept {
+    head.store(head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+  }
+
+  // Formats the committed records into `out`, returns whether there were any.
+  bool drain(memory_buffer &out) {
+    auto pos = tail.load(std::memory_order_relaxed);
+    auto last = head.load(std::memory_order_acquire);
+    if (pos == last) return false;
+    while (pos != last) {
+      auto header = log_header{};
+      auto record = data.get() + (pos & (capacity - 1));
+      std::memcpy(&header, record, sizeof(header));
+      if (header.decode) header.decode(record + sizeof(header), out);
+      pos += header.size;
+    }
+    tail.store(pos, std::memory_order_release);
+    return true;
+  }
+};
+
+// Arguments are copied as raw bytes when `log_by_value`, as characters when
+// they are strings, and otherwise formatted on the calling thread.
+template<typename T>
+inline constexpr bool is_log_trivial = log_by_value<T>::value && std::is_trivially_copyable_v<T> && !std::is_convertible_v<const T &, std::string_view>;
+
+template<typename T>
+using log_stored_t = std::conditional_t<is_log_trivial<T>, T, std::string_view>;
+
+template<typename T>
+inline auto log_prepare(const T &arg) {
+  if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+    return std::string_view(arg);
+  } else if constexpr (is_log_trivial<T>) {
+    return arg;
+  } else {
+    return to_string(arg);
+  }
+}
+
+template<typename T>
+inline std::size_t log_size(const T &arg) {
+  if constexpr (is_log_trivial<T>) {
+    return sizeof(T);
+  } else {
+    return sizeof(std::size_t) + std::string_view(arg).size();
+  }
+}
+
+template<typename T>
+inline char *log_encode(char *p, const T &arg) {
+  if constexpr (is_log_trivial<T>) {
+    std::memcpy(p, &arg, sizeof(T));
+    return p + sizeof(T);
+  } else {
+    auto str = std::string_view(arg);
+    auto size = str.size();
+    std::memcpy(p, &size, sizeof(size));
+    std::memcpy(p + sizeof(size), str.data(), size);
+    return p + sizeof(size) + size;
+  }
+}
+
+template<typename T>
+inline T log_decode(const char *&p) {
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    auto size = std::size_t{};
+    std::memcpy(&size, p, sizeof(size));
+    auto str = std::string_view(p + sizeof(size), size);
+    p += sizeof(size) + size;
+    return str;
+  } else {
+    alignas(T) unsigned char raw[sizeof(T)];
+    std::memcpy(raw, p, sizeof(T));
+    p += sizeof(T);
+    return *std::launder(reinterpret_cast<T *>(raw));
+  }
+}
+
+// One instantiation per format string and argument types; its address is
+// the record's format id.
+template<typename Fmt, typename... Stored>
+inline void log_format(const char *p, memory_buffer &out) {
+  auto args = std::tuple<Stored...>{log_decode<Stored>(p)...};
+  std::apply([&out](const auto &...args) { format_to(out, Fmt{}, args...); }, args);
+  out.push_back('\n');
+}
+
+} // namespace detail
+
+// Asynchronous logger: `log` copies its arguments into a ring owned by the
+// calling thread, a background thread formats the records and writes them
+// to the file in batches.
+struct logger {
+  private:
+  static constexpr std::size_t batch = 1 << 16;
+
+  std::FILE *file;
+  bool owns_file;
+  log_policy policy;
+  std::size_t ring_size;
+  std::size_t id;
+  std::shared_ptr<const void> alive = std::make_shared<char>();
+  std::mutex mutex{};
+  std::vector<std::shared_ptr<detail::log_ring>> rings{};
+  std::atomic<bool> stopping{false};
+  std::atomic<std::size_t> sweeps{0};
+  std::atomic<std::size_t> dropped_{0};
+  std::thread worker{};
+
+  static std::size_t next_id() {
+    static auto ids = std::atomic<std::size_t>{0};
+    return ++ids;
+  }
+
+  static std::size_t round_up(std::size_t size) {
+    auto capacity = std::size_t{1024};
+    while (capacity < size) capacity *= 2;
+    return capacity;
+  }
+
+  void write(memory_buffer &buffer) {
+    if (buffer.empty()) return;
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    std::fflush(file);
+    buffer.clear();
+  }
+
+  void work() {
+    auto buffer = memory_buffer{};
+    for (;;) {
+      auto stop = stopping.load(std::memory_order_acquire);
+      auto busy = false;
+      {
+        auto lock = std::lock_guard{mutex};
+        for (auto it = rings.begin(); it != rings.end();) {
+          // A ring whose thread has exited before the drain gets no more
+          // records, so draining it empties it for good.
+          auto orphaned = it->use_count() == 1;
+          std::atomic_thread_fence(std::memory_order_acquire);
+          auto drained = (*it)->drain(buffer);
+          busy = busy || drained;
+          if (buffer.size() >= batch) write(buffer);
+          it = orphaned ? rings.erase(it) : it + 1;
+        }
+      }
+      write(buffer);
+      sweeps.fetch_add(1, std::memory_order_release);
+      if (stop && !busy) return;
+      if (!busy) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  struct local_entry {
+    std::size_t id;
+    std::weak_ptr<const void> alive;
+    std::shared_ptr<detail::log_ring> ring;
+  };
+
+  // The rings of the calling thread, one per logger it has used. Entries of
+  // destroyed loggers are released on the next lookup.
+  detail::log_ring &local_ring() {
+    thread_local auto local = std::vector<local_entry>{};
+    for (auto &&entry : local) {
+      if (entry.id == id) return *entry.ring;
+    }
+    local.erase(std::remove_if(local.begin(), local.end(), [](const local_entry &entry) { return entry.alive.expired(); }), local.end());
+    auto ring = std::make_shared<detail::log_ring>(ring_size);
+    {
+      auto lock = std::lock_guard{mutex};
+      rings.push_back(ring);
+    }
+    local.push_back(local_entry{id, alive, ring});
+    return *local.back().ring;
+  }
+
+  public:
+  // Each thread gets a ring of `ring_size` bytes, rounded up to a power of two.
+  explicit logger(std::FILE *file = stderr, log_policy policy = log_policy::drop, std::size_t ring_size = 1 << 20)
+      : file(file), owns_file(false), policy(policy), ring_size(round_up(ring_size)), id(next_id()) {
+    worker = std::thread([this] { work(); });
+  }
+
+  explicit logger(const std::filesystem::path &path, log_policy policy = log_policy::drop, std::size_t ring_size = 1 << 20)
+      : logger(std::fopen(path.string().c_str(), "ab"), policy, ring_size) {
+    if (!file) throw std::system_error(errno, std::generic_category(), path.string());
+    owns_file = true;
+  }
+
+  logger(const logger &) = delete;
+
+  ~logger() {
+    stopping.store(true, std::memory_order_release);
+    worker.join();
+    if (owns_file) std::fclose(file);
+  }
+
+  // Returns false when the record was dropped.
+  template<typename Str, typename... Args>
+  bool log(fmt<Str>, const Args &...args) {
+    static_assert(fmt<Str>::args == sizeof...(Args), "whl::log: argument count does not match the format string");
+    auto decode = &detail::log_format<fmt<Str>, detail::log_stored_t<Args>...>;
+    auto prepared = std::tuple{detail::log_prepare(args)...};
+    auto used = std::apply([](const auto &...args) { return (sizeof(detail::log_header) + ... + detail::log_size(args)); }, prepared);
+    auto size = (used + sizeof(detail::log_header) - 1) / sizeof(detail::log_header) * sizeof(detail::log_header);
+    auto &ring = local_ring();
+    auto record = size <= ring.capacity ? ring.reserve(size) : nullptr;
+    while (!record && policy == log_policy::block && size <= ring.capacity) {
+      std::this_thread::yield();
+      record = ring.reserve(size);
+    }
+    if (!record) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    auto header = detail::log_header{size, decode};
+    std::memcpy(record, &header, sizeof(header));
+    std::apply([record](const auto &...args) {
+      auto p = record + sizeof(detail::log_header);
+      (..., (p = detail::log_encode(p, args)));
+    },
+               prepared);
+    ring.commit(size);
+    return true;
+  }
+
+  // Waits until everything logged before the call is written.
+  void flush() {
+    auto target = sweeps.load(std::memory_order_acquire) + 2;
+    while (sweeps.load(std::memory_order_acquire) < target) {
+      std::this_thread::yield();
+    }
+  }
+
+  std::size_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+};
+
+inline logger &default_logger() {
+  static auto instance = logger{};
+  return instance;
+}
+
+// Logs to standard error through the default logger.
+template<typename Str, typename... Args>
+inline bool log(fmt<Str> fmt, const Args &...args) {
+  return default_logger().log(fmt, args...);
+}
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+template<fixed_string S, typename... Args>
+inline bool log(const Args &...args) {
+  return log(fmt<fixed_str<S>>{}, args...);
+}
+#endif
+
+} // namespace whl
+
+#endif // WHEEL_WHL_LOG_HPP
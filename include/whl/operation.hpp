@@ -28,21 +28,227 @@
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <optional>
 #include <random>
+#include <stdexcept>
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "whl/container.hpp"
 #include "whl/format.hpp"
+#include "whl/function.hpp"
+#include "whl/parallel.hpp"
 #include "whl/print.hpp"
 #include "whl/sequence.hpp"
+#include "whl/simd.hpp"
 #include "whl/type.hpp"
 
+namespace whl::detail {
+
+// Borrows an lvalue range, or shares ownership of an rvalue one, so that
+// sequences built on top of it stay cheap to copy.
+template<typename R>
+struct holder {
+  private:
+  std::shared_ptr<R> ptr;
+
+  public:
+  explicit holder(R &&range) : ptr(std::make_shared<R>(std::move(range))) {}
+
+  R &get() const noexcept {
+    return *ptr;
+  }
+};
+
+template<typename R>
+struct holder<R &> {
+  private:
+  R *ptr;
+
+  public:
+  explicit holder(R &range) : ptr(&range) {}
+
+  R &get() const noexcept {
+    return *ptr;
+  }
+};
+
+template<typename Iter>
+using iter_reference_t = decltype(*std::declval<Iter &>());
+
+// Whether the call is evaluated as a constant expression; compilers without
+// a way to tell report true, which keeps callers on their portable path.
+constexpr bool is_constant_evaluated() noexcept {
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+  return __builtin_is_constant_evaluated();
+#else
+  return true;
+#endif
+#elif defined(_MSC_VER) && _MSC_VER >= 1925
+  return __builtin_is_constant_evaluated();
+#else
+  return true;
+#endif
+}
+
+template<typename... Ts>
+struct zip_tuple {
+  using type = std::tuple<Ts...>;
+};
+
+template<typename T1, typename T2>
+struct zip_tuple<T1, T2> {
+  using type = std::pair<T1, T2>;
+};
+
+template<typename... Ts>
+using zip_tuple_t = typename zip_tuple<Ts...>::type;
+
+// Stand-in for std::optional that can be assigned in constant expressions,
+// which std::optional only allows from C++20. Types that cannot be default
+// constructed and assigned use std::optional.
+template<typename T, bool = std::is_default_constructible_v<T> &&std::is_copy_assignable_v<T>>
+struct slot {
+  T value{};
+  bool engaged{};
+
+  constexpr explicit operator bool() const noexcept {
+    return engaged;
+  }
+
+  template<typename U>
+  constexpr void emplace(U &&v) {
+    value = std::forward<U>(v);
+    engaged = true;
+  }
+
+  constexpr void reset() noexcept {
+    engaged = false;
+  }
+
+  constexpr T &operator*() noexcept {
+    return value;
+  }
+
+  constexpr const T &operator*() const noexcept {
+    return value;
+  }
+};
+
+template<typename T>
+struct slot<T, false> : std::optional<T> {};
+
+// std::accumulate, which is not constexpr before C++20.
+template<typename Iter, typename Val, typename BinOp>
+constexpr Val accumulate(Iter first, Iter last, Val acc, BinOp &op) {
+  for (; first != last; ++first) {
+    acc = op(std::move(acc), *first);
+  }
+  return acc;
+}
+
+template<typename T>
+struct is_std_array : std::false_type {};
+
+template<typename T, std::size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type {};
+
+template<typename T>
+struct type_tag {
+  using type = T;
+};
+
+// Push-style accumulator: `step(state, x)` per element, then `finish(state)`.
+template<typename State, typename Step, typename Finish>
+struct accumulator {
+  State state;
+  Step step;
+  Finish finish;
+
+  template<typename T>
+  constexpr void operator()(T &&x) {
+    step(state, std::forward<T>(x));
+  }
+
+  constexpr auto result() {
+    return finish(state);
+  }
+};
+
+template<typename State, typename Step, typename Finish>
+accumulator(State, Step, Finish) -> accumulator<State, Step, Finish>;
+
+// A terminal operation that can also run as an accumulator, so that several
+// of them can share one traversal. `make(type_tag<T>)` builds the accumulator
+// for elements of type T.
+template<typename Run, typename Make>
+struct terminal : Run {
+  Make make;
+
+  constexpr terminal(Run run, Make make) : Run(std::move(run)), make(std::move(make)) {}
+
+  template<typename T>
+  constexpr auto accumulator() const {
+    return make(type_tag<T>{});
+  }
+};
+
+// Result of a stage that hands its input on: lvalues by reference, rvalues
+// moved into a new value.
+template<typename T>
+using pass_t = std::conditional_t<std::is_lvalue_reference_v<T>, T, remove_cr_t<T>>;
+
+template<typename C, typename = void>
+struct is_segmented : std::false_type {};
+
+template<typename C>
+struct is_segmented<C, std::enable_if_t<C::segmented>> : std::true_type {};
+
+// Calls `fn(first, last)` once per contiguous segment of `cont`: once for
+// ordinary ranges, once per input for concatenations.
+template<typename C, typename Fn>
+constexpr inline void for_each_segment(C &&cont, Fn &&fn) {
+  if constexpr (is_segmented<remove_cr_t<C>>::value) {
+    cont.segments(fn);
+  } else {
+    fn(std::begin(cont), std::end(cont));
+  }
+}
+
+template<typename C, typename = void>
+struct has_size : std::false_type {};
+
+template<typename C>
+struct has_size<C, decltype(std::size(std::declval<C &>()), void())> : std::true_type {};
+
+template<typename C, typename Iter, typename = void>
+struct has_range_insert : std::false_type {};
+
+template<typename C, typename Iter>
+struct has_range_insert<C, Iter, decltype(std::declval<C &>().insert(std::end(std::declval<C &>()), std::declval<Iter>(), std::declval<Iter>()), void())>
+    : std::true_type {};
+
+template<typename C, typename Iter>
+inline void append_range(C &cont, Iter first, Iter last) {
+  if constexpr (has_range_insert<C, Iter>::value) {
+    cont.insert(std::end(cont), first, last);
+  } else {
+    cont.insert(first, last);
+  }
+}
+
+} // namespace whl::detail
+
 namespace whl::op {
 
 template<typename Fn>
@@ -51,24 +257,24 @@ struct operation : Fn {
   constexpr explicit operation(Fn &&fn) : Fn(std::move(fn)) {}
 
   template<typename T>
-  friend constexpr inline auto operator|(const T &val, operation<Fn> op) {
-    return op(val);
+  friend constexpr inline decltype(auto) operator|(T &&val, operation<Fn> op) {
+    return op(std::forward<T>(val));
   }
 };
 
 template<typename Fn>
 constexpr inline auto foreach (Fn fn) {
-  return operation{[fn](auto &&cont) {
-    std::for_each(std::begin(cont), std::end(cont), fn);
-    return cont;
+  return operation{[fn](auto &&cont) -> detail::pass_t<decltype(cont)> {
+    detail::for_each_segment(cont, [&fn](auto first, auto last) { std::for_each(first, last, fn); });
+    return std::forward<decltype(cont)>(cont);
   }};
 }
 
 template<typename Fn>
 constexpr inline auto foreach_indexed(Fn fn) {
-  return operation{[fn](auto &&cont) {
+  return operation{[fn](auto &&cont) -> detail::pass_t<decltype(cont)> {
     whl::foreach_indexed(cont, fn);
-    return cont;
+    return std::forward<decltype(cont)>(cont);
   }};
 }
 
@@ -82,36 +288,36 @@ struct map_iter {
   using value_type = remove_cr_t<decltype(fn(std::declval<typename std::iterator_traits<Iter>::value_type>()))>;
   using pointer = std::optional<value_type>;
   using reference = value_type &;
-  using difference_type = typename Iter::difference_type;
+  using difference_type = typename std::iterator_traits<Iter>::difference_type;
   using iterator_category = std::input_iterator_tag;
 
   public:
   constexpr map_iter(Iter iter, Fn fn) : iter(iter), fn(std::move(fn)){};
 
-  value_type operator*() {
+  constexpr value_type operator*() {
     return fn(*iter);
   }
 
-  pointer operator->() {
+  constexpr pointer operator->() {
     return **this;
   }
 
-  map_iter &operator++() {
+  constexpr map_iter &operator++() {
     ++iter;
     return *this;
   }
 
-  map_iter operator++(int) {
+  constexpr map_iter operator++(int) {
     auto it = *this;
     ++*this;
     return it;
   }
 
-  bool operator!=(const map_iter &it) {
+  constexpr bool operator!=(const map_iter &it) {
     return !(*this == it);
   }
 
-  bool operator==(const map_iter &it) {
+  constexpr bool operator==(const map_iter &it) {
     return iter == it.iter;
   }
 };
@@ -127,7 +333,7 @@ template<typename Iter>
 struct flatten_iter {
   private:
   Iter iter;
-  using iter_value_type = typename Iter::value_type;
+  using iter_value_type = typename std::iterator_traits<Iter>::value_type;
   using inner_iter_type = typename iter_value_type::iterator;
   std::optional<iter_value_type> value{};
   std::optional<inner_iter_type> inner_iter{};
@@ -199,59 +405,98 @@ constexpr inline auto flat_map(Fn fn) {
   }};
 }
 
+// Collects the range into `C`. A `std::array` must receive exactly as many
+// elements as it holds.
 template<typename C>
 constexpr inline auto to() {
   return operation{[](auto &&cont) {
-    return C(std::begin(cont), std::end(cont));
+    using cont_type = decltype(cont);
+    if constexpr (std::is_same_v<cont_type, C &&>) {
+      return C(std::move(cont));
+    } else if constexpr (detail::is_std_array<C>::value) {
+      auto result = C{};
+      auto i = std::size_t{};
+      auto overflow = false;
+      detail::for_each_segment(cont, [&result, &i, &overflow](auto first, auto last) {
+        for (; i < result.size() && first != last; ++i, ++first) {
+          result[i] = *first;
+        }
+        overflow = overflow || first != last;
+      });
+      // A length mismatch fails to compile in constant evaluation.
+      if ((overflow || i != result.size()) && detail::is_constant_evaluated()) {
+        throw std::length_error("whl::op::to: the range does not fit the array exactly");
+      }
+      assert(!overflow && i == result.size());
+      return result;
+    } else if constexpr (detail::is_segmented<remove_cr_t<cont_type>>::value) {
+      auto result = C{};
+      cont.segments([&result](auto first, auto last) { detail::append_range(result, first, last); });
+      return result;
+    } else {
+      return C(std::begin(cont), std::end(cont));
+    }
   }};
 }
 
 template<template<typename...> typename C>
 constexpr inline auto to() {
   return operation{[](auto &&cont) {
-    return C(std::begin(cont), std::end(cont));
+    using result_type = decltype(C(std::begin(cont), std::end(cont)));
+    return std::forward<decltype(cont)>(cont) | to<result_type>();
   }};
 }
 
-template<typename Iter, typename OtherIter, typename Fn>
+template<typename... Iters>
 struct zip_iter {
-  private:
-  Iter iter, iter_end;
-  OtherIter other_iter, other_iter_end;
-  const Fn zipper;
-
   public:
-  using difference_type = typename Iter::difference_type;
-  using value_type = remove_cr_t<decltype(zipper(std::declval<typename Iter::value_type>(),
-                                                 std::declval<typename OtherIter::value_type>()))>;
+  static constexpr bool random_access = (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iters>::iterator_category> && ...);
+
+  using difference_type = std::ptrdiff_t;
+  using reference = detail::zip_tuple_t<detail::iter_reference_t<Iters>...>;
+  using value_type = detail::zip_tuple_t<remove_cr_t<detail::iter_reference_t<Iters>>...>;
   using pointer = std::optional<value_type>;
-  using reference = value_type &;
-  using iterator_category = std::input_iterator_tag;
+  using iterator_category = std::conditional_t<random_access, std::random_access_iterator_tag, std::input_iterator_tag>;
 
-  public:
-  constexpr zip_iter(Iter iter, Iter end, OtherIter other, OtherIter other_end, Fn zipper)
-      : iter(iter), iter_end(end), other_iter(other), other_iter_end(other_end), zipper(zipper){};
+  private:
+  std::tuple<Iters...> iters, ends;
 
-  constexpr zip_iter(Iter end, OtherIter other_end, Fn zipper)
-      : iter(end), iter_end(end), other_iter(other_end), other_iter_end(other_end), zipper(zipper){};
+  template<std::size_t... I>
+  reference deref(std::index_sequence<I...>) {
+    return reference(*std::get<I>(iters)...);
+  }
 
-  constexpr value_type operator*() {
-    return zipper(*iter, *other_iter);
+  template<std::size_t... I>
+  bool any_end(std::index_sequence<I...>) {
+    return (... || (std::get<I>(iters) == std::get<I>(ends)));
   }
 
-  zip_iter &operator++() {
-    ++iter;
-    ++other_iter;
-    if (other_iter == other_iter_end) {
-      iter = iter_end;
+  public:
+  // Random-access inputs must already be clamped to the shortest length,
+  // other inputs stop as soon as any of them reaches its end.
+  constexpr zip_iter(std::tuple<Iters...> iters, std::tuple<Iters...> ends)
+      : iters(std::move(iters)), ends(std::move(ends)) {
+    if constexpr (!random_access) {
+      if (any_end(std::index_sequence_for<Iters...>())) this->iters = this->ends;
     }
-    return *this;
+  }
+
+  reference operator*() {
+    return deref(std::index_sequence_for<Iters...>());
   }
 
   pointer operator->() {
     return **this;
   }
 
+  zip_iter &operator++() {
+    std::apply([](auto &...it) { (..., ++it); }, iters);
+    if constexpr (!random_access) {
+      if (any_end(std::index_sequence_for<Iters...>())) iters = ends;
+    }
+    return *this;
+  }
+
   zip_iter operator++(int) {
     auto it = *this;
     ++*this;
@@ -263,14 +508,80 @@ struct zip_iter {
   }
 
   bool operator==(const zip_iter &it) {
-    return iter == it.iter;
+    return std::get<0>(iters) == std::get<0>(it.iters);
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  zip_iter &operator--() {
+    std::apply([](auto &...it) { (..., --it); }, iters);
+    return *this;
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  zip_iter operator--(int) {
+    auto it = *this;
+    --*this;
+    return it;
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  zip_iter &operator+=(difference_type n) {
+    std::apply([n](auto &...it) { (..., (it += n)); }, iters);
+    return *this;
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  zip_iter &operator-=(difference_type n) {
+    return *this += -n;
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  zip_iter operator+(difference_type n) const {
+    auto it = *this;
+    return it += n;
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  zip_iter operator-(difference_type n) const {
+    auto it = *this;
+    return it -= n;
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  difference_type operator-(const zip_iter &it) const {
+    return std::get<0>(iters) - std::get<0>(it.iters);
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  reference operator[](difference_type n) const {
+    return *(*this + n);
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  bool operator<(const zip_iter &it) const {
+    return std::get<0>(iters) < std::get<0>(it.iters);
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  bool operator>(const zip_iter &it) const {
+    return it < *this;
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  bool operator<=(const zip_iter &it) const {
+    return !(it < *this);
+  }
+
+  template<bool RA = random_access, typename = std::enable_if_t<RA>>
+  bool operator>=(const zip_iter &it) const {
+    return !(*this < it);
   }
 };
 
-template<typename Iter, typename C, typename Fn>
+template<typename Iter, typename... Holders>
 struct zip_sequence {
   public:
-  using const_iterator = zip_iter<Iter, typename C::const_iterator, Fn>;
+  using const_iterator = zip_iter<Iter, decltype(std::begin(std::declval<Holders>().get()))...>;
   using iterator = const_iterator;
   using value_type = typename iterator::value_type;
   using pointer = typename iterator::pointer;
@@ -280,33 +591,55 @@ struct zip_sequence {
   using difference_type = typename iterator::difference_type;
 
   private:
-  C other;
   Iter first, last;
-  const Fn zipper;
+  std::tuple<Holders...> others;
+
+  auto bounds() const {
+    auto begins = std::apply([this](auto &...h) { return std::make_tuple(first, std::begin(h.get())...); }, others);
+    auto ends = std::apply([this](auto &...h) { return std::make_tuple(last, std::end(h.get())...); }, others);
+    if constexpr (iterator::random_access) {
+      auto n = std::apply([&ends](auto &...begin) {
+        return std::apply([&begin...](auto &...end) {
+          return std::min({static_cast<difference_type>(end - begin)...});
+        },
+                          ends);
+      },
+                          begins);
+      ends = std::apply([n](auto &...begin) { return std::make_tuple((begin + n)...); }, begins);
+    }
+    return std::make_pair(begins, ends);
+  }
 
   public:
-  zip_sequence(Iter first, Iter last, const C &other, Fn zipper)
-      : first(first), last(last), other(other), zipper(zipper) {}
+  zip_sequence(Iter first, Iter last, std::tuple<Holders...> others)
+      : first(first), last(last), others(std::move(others)) {}
 
   iterator begin() const {
-    return {first, last, std::begin(other), std::end(other), zipper};
+    auto [begins, ends] = bounds();
+    return {begins, ends};
   }
 
   iterator end() const {
-    return {last, std::end(other), zipper};
+    auto [begins, ends] = bounds();
+    return {ends, ends};
   }
 };
 
-template<typename C, typename Fn>
-constexpr inline auto zip(const C &other, Fn fn) {
-  return operation{[&other, fn](auto &&cont) {
-    return zip_sequence{std::begin(cont), std::end(cont), other, fn};
+// Zips the piped range with any number of other ranges into tuples (pairs when
+// zipping two) of their references, stopping at the shortest one. Lvalue
+// ranges are borrowed and must outlive the result, rvalue ranges are owned.
+template<typename... Rs, std::enable_if_t<(sizeof...(Rs) > 0) && (is_iterable_v<Rs> && ...), int> = 0>
+constexpr inline auto zip(Rs &&...others) {
+  return operation{[others = std::make_tuple(detail::holder<Rs>(std::forward<Rs>(others))...)](auto &&cont) {
+    return zip_sequence{std::begin(cont), std::end(cont), others};
   }};
 }
 
-template<typename C>
-constexpr inline auto zip(const C &other) {
-  return zip(other, [](auto &&x, auto &&y) { return std::make_pair(x, y); });
+template<typename C, typename Fn, std::enable_if_t<!is_iterable_v<Fn>, int> = 0>
+constexpr inline auto zip(C &&other, Fn fn) {
+  return operation{[zip = zip(std::forward<C>(other)), fn](auto &&cont) {
+    return zip(cont) | map([fn](auto &&it) { return std::apply(fn, it); });
+  }};
 }
 
 template<template<typename...> typename R1 = std::vector, template<typename...> typename R2 = R1, typename Fn>
@@ -328,28 +661,93 @@ constexpr inline auto unzip() {
   return unzip<R1, R2>(func::identity);
 }
 
+} // namespace whl::op
+
+namespace whl::detail {
+
+template<typename Op>
+struct simd_compare;
+
+template<>
+struct simd_compare<std::equal_to<>> : std::integral_constant<simd::compare, simd::compare::equal> {};
+
+template<>
+struct simd_compare<std::not_equal_to<>> : std::integral_constant<simd::compare, simd::compare::not_equal> {};
+
+template<>
+struct simd_compare<std::less<>> : std::integral_constant<simd::compare, simd::compare::less> {};
+
+template<>
+struct simd_compare<std::less_equal<>> : std::integral_constant<simd::compare, simd::compare::less_equal> {};
+
+template<>
+struct simd_compare<std::greater<>> : std::integral_constant<simd::compare, simd::compare::greater> {};
+
+template<>
+struct simd_compare<std::greater_equal<>> : std::integral_constant<simd::compare, simd::compare::greater_equal> {};
+
+// The bound of `pred` converted to `T`, if that keeps the comparison exact.
+template<typename T, typename Op, typename Val>
+constexpr std::optional<T> exact_bound(const func::bound_compare<Op, Val> &pred) {
+  auto bound = static_cast<T>(pred.value);
+  if (std::is_same_v<Val, T> || (std::is_floating_point_v<T> && static_cast<Val>(bound) == pred.value)) {
+    return bound;
+  }
+  return std::nullopt;
+}
+
+template<typename Iter, typename Pred>
+struct is_simd_filter : std::false_type {};
+
+// Pointers and vector iterators over element types `simd::find_compare`
+// scans a register at a time, filtered by a `whl::func` comparison.
+template<typename Iter, typename Op, typename Val>
+struct is_simd_filter<Iter, func::bound_compare<Op, Val>> {
+  using value_type = typename std::iterator_traits<Iter>::value_type;
+  static constexpr bool value = simd::detail::has_block_mask<value_type> && std::is_arithmetic_v<Val>
+                             && (std::is_pointer_v<Iter>
+                                 || std::is_same_v<Iter, typename std::vector<value_type>::iterator>
+                                 || std::is_same_v<Iter, typename std::vector<value_type>::const_iterator>);
+};
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+// Lazily yields the elements matching the predicate. Over contiguous 32-bit
+// integers, floats and doubles, the comparisons of `whl::func` skip to the
+// next match a SIMD register at a time outside constant evaluation.
 template<typename Iter, typename Pred>
 struct filter_iter {
   public:
-  using difference_type = typename Iter::difference_type;
-  using value_type = typename Iter::value_type;
+  using difference_type = typename std::iterator_traits<Iter>::difference_type;
+  using value_type = typename std::iterator_traits<Iter>::value_type;
   using pointer = std::optional<value_type>;
-  using reference = typename Iter::reference;
+  using reference = typename std::iterator_traits<Iter>::reference;
   using iterator_category = std::input_iterator_tag;
 
   private:
   Iter iter, iter_end;
   const Pred pred;
-  std::optional<value_type> value{};
+  detail::slot<value_type> value{};
+
+  template<typename Op, typename Val>
+  void skip(const func::bound_compare<Op, Val> &compare) {
+    if (auto bound = detail::exact_bound<value_type>(compare)) {
+      auto first = std::addressof(*iter);
+      auto last = first + (iter_end - iter);
+      iter += simd::find_compare<detail::simd_compare<Op>::value>(first, last, *bound) - first;
+    }
+  }
 
-  void eval_value() {
-    if (iter == iter_end) return;
-    if (value) return;
-    value = *iter;
-    if (!pred(*value)) {
-      ++iter;
+  constexpr void eval_value() {
+    if constexpr (detail::is_simd_filter<Iter, Pred>::value) {
+      if (!value && iter != iter_end && !detail::is_constant_evaluated()) skip(pred);
+    }
+    for (; !value && iter != iter_end; ++iter) {
+      value.emplace(*iter);
+      if (pred(*value)) return;
       value.reset();
-      eval_value();
     }
   }
 
@@ -360,39 +758,89 @@ struct filter_iter {
   constexpr filter_iter(Iter end, Pred pred)
       : iter(end), iter_end(end), pred(pred){};
 
-  value_type operator*() {
+  constexpr value_type operator*() {
     eval_value();
     return *value;
   }
 
-  filter_iter &operator++() {
+  constexpr filter_iter &operator++() {
     ++iter;
     value.reset();
     eval_value();
     return *this;
   }
 
-  pointer operator->() {
+  constexpr pointer operator->() {
     eval_value();
-    return value;
+    return pointer{*value};
   }
 
-  filter_iter operator++(int) {
+  constexpr filter_iter operator++(int) {
     auto it = *this;
     ++*this;
     return it;
   }
 
-  bool operator!=(const filter_iter &it) {
+  constexpr bool operator!=(const filter_iter &it) {
     return !(*this == it);
   }
 
-  bool operator==(const filter_iter &it) {
+  constexpr bool operator==(const filter_iter &it) {
     eval_value();
     return iter == it.iter;
   }
 };
 
+} // namespace whl::op
+
+namespace whl::detail {
+
+template<typename C, typename Pred>
+struct is_compactable : std::false_type {};
+
+template<typename C, typename Val>
+struct has_compactable_elements {
+  using value_type = remove_cr_t<decltype(*std::data(std::declval<C &>()))>;
+  static constexpr bool value = std::is_arithmetic_v<value_type> && !std::is_same_v<value_type, bool> && std::is_arithmetic_v<Val>;
+};
+
+template<typename C, typename Op, typename Val>
+struct is_compactable<C, func::bound_compare<Op, Val>> : std::conjunction<is_contiguous<C>, has_compactable_elements<C, Val>> {};
+
+// Copies the matching elements into a vector with `simd::compress`, a chunk
+// at a time through a local buffer so that only the kept elements are
+// allocated. The bound is converted to the element type only if that keeps
+// the comparison exact, otherwise the branchless loop uses the predicate
+// itself.
+template<typename C, typename Op, typename Val>
+inline auto compact(C &cont, const func::bound_compare<Op, Val> &pred) {
+  using value_type = remove_cr_t<decltype(*std::data(cont))>;
+  constexpr auto chunk_size = std::size_t{256};
+  auto first = std::data(cont);
+  auto size = static_cast<std::size_t>(std::size(cont));
+  auto result = std::vector<value_type>{};
+  auto bound = exact_bound<value_type>(pred);
+  value_type chunk[chunk_size];
+  for (std::size_t i = 0; i < size; i += chunk_size) {
+    auto m = std::min(chunk_size, size - i);
+    auto n = std::size_t{};
+    if (bound) {
+      n = simd::compress<simd_compare<Op>::value>(first + i, first + i + m, *bound, chunk);
+    } else {
+      for (std::size_t j = 0; j < m; ++j) {
+        chunk[n] = first[i + j];
+        n += static_cast<std::size_t>(pred(first[i + j]));
+      }
+    }
+    result.insert(result.end(), chunk, chunk + n);
+  }
+  return result;
+}
+
+} // namespace whl::detail
+
+namespace whl::op {
+
 template<typename Pred>
 constexpr inline auto filter(Pred pred) {
   return operation{[pred](auto &&cont) {
@@ -400,13 +848,37 @@ constexpr inline auto filter(Pred pred) {
   }};
 }
 
+// Eager `filter` into a vector. Contiguous arithmetic ranges filtered by the
+// comparison predicates of `whl::func` (`great_than(x)` and friends) are
+// scanned a SIMD register at a time.
+template<typename Pred>
+inline auto compact(Pred pred) {
+  return operation{[pred](auto &&cont) {
+    if constexpr (detail::is_compactable<std::remove_reference_t<decltype(cont)>, Pred>::value) {
+      return detail::compact(cont, pred);
+    } else {
+      auto result = std::vector<remove_cr_t<decltype(*std::begin(cont))>>{};
+      std::copy_if(std::begin(cont), std::end(cont), std::back_inserter(result), pred);
+      return result;
+    }
+  }};
+}
+
+// Rvalues of the result type are deduplicated in place, anything else is
+// copied into a new container.
 template<template<typename...> typename C = std::vector, typename Eq>
 constexpr inline auto distinct(Eq eq) {
   return operation{[eq](auto &&cont) {
     using value_type = remove_cr_t<decltype(*std::begin(cont))>;
-    auto result = C<value_type>{};
-    std::unique_copy(std::begin(cont), std::end(cont), std::back_inserter(result), eq);
-    return result;
+    if constexpr (std::is_same_v<decltype(cont), C<value_type> &&>) {
+      auto result = C<value_type>(std::move(cont));
+      result.erase(std::unique(std::begin(result), std::end(result), eq), std::end(result));
+      return result;
+    } else {
+      auto result = C<value_type>{};
+      std::unique_copy(std::begin(cont), std::end(cont), std::back_inserter(result), eq);
+      return result;
+    }
   }};
 }
 
@@ -421,11 +893,13 @@ constexpr inline auto reverse() {
   }};
 }
 
+// Rvalues of the result type are sorted in place, anything else is copied
+// into a new container first.
 template<template<typename...> typename C = std::vector, typename Comp>
 constexpr inline auto sort(Comp comp) {
   return operation{[comp](auto &&cont) {
     using value_type = remove_cr_t<decltype(*std::begin(cont))>;
-    auto result = C<value_type>(std::begin(cont), std::end(cont));
+    auto result = std::forward<decltype(cont)>(cont) | to<C<value_type>>();
     std::sort(std::begin(result), std::end(result), comp);
     return result;
   }};
@@ -440,7 +914,7 @@ template<template<typename...> typename C = std::vector>
 constexpr inline auto shuffle() {
   return operation{[](auto &&cont) {
     using value_type = remove_cr_t<decltype(*std::begin(cont))>;
-    auto result = C<value_type>(std::begin(cont), std::end(cont));
+    auto result = std::forward<decltype(cont)>(cont) | to<C<value_type>>();
     auto time = std::chrono::system_clock::now().time_since_epoch().count();
     std::shuffle(std::begin(result), std::end(result), std::default_random_engine(time));
     return result;
@@ -467,19 +941,39 @@ constexpr inline auto drop(Size n) {
 
 template<typename Val, typename BinOp>
 constexpr inline auto fold(Val init, BinOp op) {
-  return operation{[init, op](auto &&cont) {
-    return std::accumulate(std::begin(cont), std::end(cont), init, op);
-  }};
+  auto run = [init, op](auto &&cont) {
+    auto acc = init;
+    detail::for_each_segment(cont, [&acc, &op](auto first, auto last) { acc = detail::accumulate(first, last, std::move(acc), op); });
+    return acc;
+  };
+  auto make = [init, op](auto) {
+    return detail::accumulator{init, [op](auto &acc, auto &&x) { acc = op(std::move(acc), x); }, [](auto &acc) { return acc; }};
+  };
+  return operation{detail::terminal{run, make}};
 }
 
 template<typename BinOp>
 constexpr inline auto reduce(BinOp op) {
-  return operation{[op](auto &&cont) {
-    assert(std::size(cont) > 0);
-    auto begin = std::begin(cont);
-    auto init = *begin++;
-    return std::accumulate(begin, std::end(cont), init, op);
-  }};
+  auto run = [op](auto &&cont) {
+    using value_type = remove_cr_t<decltype(*std::begin(cont))>;
+    auto acc = detail::slot<value_type>{};
+    detail::for_each_segment(cont, [&acc, &op](auto first, auto last) {
+      if (first == last) return;
+      if (!acc) {
+        acc.emplace(*first);
+        ++first;
+      }
+      *acc = detail::accumulate(first, last, std::move(*acc), op);
+    });
+    assert(acc);
+    return *acc;
+  };
+  auto make = [op](auto tag) {
+    using value_type = typename decltype(tag)::type;
+    auto step = [op](auto &acc, auto &&x) { acc = acc ? op(std::move(*acc), x) : x; };
+    return detail::accumulator{std::optional<value_type>{}, step, [](auto &acc) { return *acc; }};
+  };
+  return operation{detail::terminal{run, make}};
 }
 
 template<typename Out, typename Dlm>
@@ -499,140 +993,995 @@ constexpr inline auto join_to(Out &out, const Dlm &delimiter) {
 template<typename CharT = char, typename Dlm>
 constexpr inline auto join(const Dlm &delimiter) {
   return operation{[delimiter](auto &&cont) {
-    auto out = std::basic_ostringstream<CharT>{};
+    auto out = basic_memory_buffer<CharT>{};
     cont | join_to(out, delimiter);
     return out.str();
   }};
 }
 
-template<typename Val>
-constexpr inline auto sum() {
-  return fold(Val{}, func::plus);
-}
+} // namespace whl::op
+
+namespace whl::detail {
 
+// Pairwise summation: blocks of 128 elements are summed in 8 independent
+// lanes, which vectorizes, and block sums are combined as a balanced binary
+// tree through a carry stack, one level per bit of the block count. The error
+// grows with log n instead of n.
 template<typename Val>
-constexpr inline auto average() {
-  return operation([](auto &&cont) {
-    return (cont | sum<Val>()) / std::distance(std::begin(cont), std::end(cont));
-  });
-}
+struct pairwise_sum {
+  static constexpr std::size_t lanes = 8;
+  static constexpr std::size_t block = 128;
+
+  Val lane[lanes]{};
+  std::size_t fill{};
+  Val levels[64]{};
+  std::uint64_t used{};
+
+  // Adds the sum of 2^level blocks; it must come after everything pushed so
+  // far and before anything pushed later.
+  constexpr void carry(Val v, int level) {
+    for (; (used >> level) & 1; ++level) {
+      v = levels[level] + v;
+      used &= ~(std::uint64_t{1} << level);
+    }
+    levels[level] = v;
+    used |= std::uint64_t{1} << level;
+  }
 
-constexpr inline auto min() {
-  return operation{[](auto &&cont) {
-    return *std::min_element(std::begin(cont), std::end(cont));
-  }};
-}
+  template<typename T>
+  constexpr void operator()(const T &x) {
+    lane[fill % lanes] = lane[fill % lanes] + x;
+    if (++fill == block) {
+      carry(lanes_sum(lane), 0);
+      std::fill(std::begin(lane), std::end(lane), Val{});
+      fill = 0;
+    }
+  }
 
-template<typename Comp>
-constexpr inline auto min(Comp comp) {
-  return operation{[comp](auto &&cont) {
-    return *std::min_element(std::begin(cont), std::end(cont), comp);
-  }};
-}
+  template<typename T>
+  constexpr void push(const T *first, const T *last) {
+    for (; fill != 0 && first != last; ++first) {
+      (*this)(*first);
+    }
+    for (; static_cast<std::size_t>(last - first) >= block; first += block) {
+      Val sums[lanes]{};
+      for (std::size_t i = 0; i < block; i += lanes) {
+        for (std::size_t j = 0; j < lanes; ++j) {
+          sums[j] = sums[j] + first[i + j];
+        }
+      }
+      carry(lanes_sum(sums), 0);
+    }
+    for (; first != last; ++first) {
+      (*this)(*first);
+    }
+  }
 
-constexpr inline auto max() {
-  return operation{[](auto &&cont) {
-    return *std::max_element(std::begin(cont), std::end(cont));
-  }};
-}
+  constexpr Val result() const {
+    auto any = fill != 0;
+    auto sum = any ? lanes_sum(lane) : Val{};
+    for (int level = 0; level < 64; ++level) {
+      if (((used >> level) & 1) == 0) continue;
+      sum = any ? levels[level] + sum : levels[level];
+      any = true;
+    }
+    return sum;
+  }
 
-template<typename Comp>
-constexpr inline auto max(Comp comp) {
-  return operation{[comp](auto &&cont) {
-    return *std::max_element(std::begin(cont), std::end(cont), comp);
-  }};
-}
+  private:
+  static constexpr Val lanes_sum(const Val (&v)[lanes]) {
+    return ((v[0] + v[1]) + (v[2] + v[3])) + ((v[4] + v[5]) + (v[6] + v[7]));
+  }
+};
 
-constexpr inline auto count() {
-  return operation{[](auto &&cont) {
-    return std::distance(std::begin(cont), std::end(cont));
-  }};
-}
+// Kahan-Babuska-Neumaier compensated summation: the rounding error of every
+// addition is collected in `comp` and added back at the end.
+template<typename Val>
+struct neumaier_sum {
+  static constexpr std::size_t lanes = 4;
 
-template<typename Pred>
-constexpr inline auto count(Pred pred) {
-  return operation{[pred](auto &&cont) {
-    return std::count_if(std::begin(cont), std::end(cont), pred);
-  }};
-}
+  Val sum{}, comp{};
 
-template<typename Pred>
-constexpr inline auto all(Pred pred) {
-  return operation{[pred](auto &&cont) {
-    return std::all_of(std::begin(cont), std::end(cont), pred);
+  static constexpr void add(Val &sum, Val &comp, Val v) {
+    auto t = sum + v;
+    auto big = (sum < Val{} ? -sum : sum) >= (v < Val{} ? -v : v);
+    comp += big ? (sum - t) + v : (v - t) + sum;
+    sum = t;
+  }
+
+  template<typename T>
+  constexpr void operator()(const T &x) {
+    add(sum, comp, static_cast<Val>(x));
+  }
+
+  // Contiguous input runs in independent lanes, merged in a fixed order.
+  template<typename T>
+  constexpr void push(const T *first, const T *last) {
+    Val sums[lanes]{}, comps[lanes]{};
+    for (; static_cast<std::size_t>(last - first) >= lanes; first += lanes) {
+      for (std::size_t j = 0; j < lanes; ++j) {
+        add(sums[j], comps[j], static_cast<Val>(first[j]));
+      }
+    }
+    for (std::size_t j = 0; j < lanes; ++j) {
+      add(sum, comp, sums[j]);
+      comp += comps[j];
+    }
+    for (; first != last; ++first) {
+      (*this)(*first);
+    }
+  }
+
+  constexpr Val result() const {
+    return sum + comp;
+  }
+};
+
+// Pushes every element of `cont` into `acc`, contiguous ranges in bulk, and
+// returns the element count.
+template<typename Acc, typename C>
+constexpr std::ptrdiff_t sum_into(Acc &acc, C &cont) {
+  if constexpr (is_contiguous_v<C>) {
+    auto first = std::data(cont);
+    auto size = static_cast<std::ptrdiff_t>(std::size(cont));
+    acc.push(first, first + size);
+    return size;
+  } else {
+    auto n = std::ptrdiff_t{};
+    for_each_segment(cont, [&acc, &n](auto first, auto last) {
+      for (; first != last; ++first, ++n) {
+        acc(*first);
+      }
+    });
+    return n;
+  }
+}
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+// Summation policies for `sum` and `average`: `pairwise` bounds the error by
+// O(log n) and vectorizes, `kahan` compensates rounding errors (Neumaier's
+// variant), and `parallel` is pairwise summation spread over a thread pool,
+// with the same result as `pairwise` for any number of threads.
+struct pairwise_t {};
+struct kahan_t {};
+struct parallel_t {};
+
+inline constexpr auto pairwise = pairwise_t{};
+inline constexpr auto kahan = kahan_t{};
+inline constexpr auto parallel = parallel_t{};
+
+template<typename Val>
+constexpr inline auto sum() {
+  return fold(Val{}, func::plus);
+}
+
+template<typename Val, typename Policy, std::enable_if_t<std::is_same_v<Policy, pairwise_t> || std::is_same_v<Policy, kahan_t>, int> = 0>
+constexpr inline auto sum(Policy) {
+  using acc_type = std::conditional_t<std::is_same_v<Policy, kahan_t>, detail::neumaier_sum<Val>, detail::pairwise_sum<Val>>;
+  auto run = [](auto &&cont) {
+    auto acc = acc_type{};
+    detail::sum_into(acc, cont);
+    return acc.result();
+  };
+  return operation{detail::terminal{run, [](auto) { return acc_type{}; }}};
+}
+
+// Contiguous ranges are cut into fixed chunks of 64 blocks, whose sums are
+// computed concurrently and then carried in order, which reproduces the tree
+// of the sequential pairwise sum exactly.
+template<typename Val>
+inline auto sum(parallel_t, thread_pool &pool = default_pool()) {
+  auto run = [&pool](auto &&cont) {
+    auto acc = detail::pairwise_sum<Val>{};
+    if constexpr (is_contiguous_v<std::remove_reference_t<decltype(cont)>>) {
+      constexpr auto level = 6;
+      constexpr auto chunk = detail::pairwise_sum<Val>::block << level;
+      auto first = std::data(cont);
+      auto size = static_cast<std::size_t>(std::size(cont));
+      auto sums = std::vector<Val>(size / chunk);
+      parallel_for(sums.size(), [first, &sums](std::size_t i) {
+        auto part = detail::pairwise_sum<Val>{};
+        part.push(first + i * chunk, first + (i + 1) * chunk);
+        sums[i] = part.result();
+      }, pool);
+      for (auto &&s : sums) {
+        acc.carry(s, level);
+      }
+      acc.push(first + sums.size() * chunk, first + size);
+    } else {
+      detail::sum_into(acc, cont);
+    }
+    return acc.result();
+  };
+  return operation{detail::terminal{run, [](auto) { return detail::pairwise_sum<Val>{}; }}};
+}
+
+template<typename Val>
+constexpr inline auto average() {
+  auto make = [](auto) {
+    auto step = [](auto &acc, auto &&x) {
+      acc.first = func::plus(acc.first, x);
+      ++acc.second;
+    };
+    return detail::accumulator{std::pair<Val, std::ptrdiff_t>{}, step, [](auto &acc) { return acc.first / acc.second; }};
+  };
+  auto run = [make](auto &&cont) {
+    auto acc = make(detail::type_tag<void>{});
+    detail::for_each_segment(cont, [&acc](auto first, auto last) {
+      for (; first != last; ++first) {
+        acc(*first);
+      }
+    });
+    return acc.result();
+  };
+  return operation{detail::terminal{run, make}};
+}
+
+template<typename Val, typename Policy, std::enable_if_t<std::is_same_v<Policy, pairwise_t> || std::is_same_v<Policy, kahan_t>, int> = 0>
+constexpr inline auto average(Policy) {
+  using acc_type = std::conditional_t<std::is_same_v<Policy, kahan_t>, detail::neumaier_sum<Val>, detail::pairwise_sum<Val>>;
+  auto run = [](auto &&cont) {
+    auto acc = acc_type{};
+    auto n = detail::sum_into(acc, cont);
+    return acc.result() / n;
+  };
+  auto make = [](auto) {
+    auto step = [](auto &acc, auto &&x) {
+      acc.first(x);
+      ++acc.second;
+    };
+    return detail::accumulator{std::pair<acc_type, std::ptrdiff_t>{}, step, [](auto &acc) { return acc.first.result() / acc.second; }};
+  };
+  return operation{detail::terminal{run, make}};
+}
+
+template<typename Comp>
+constexpr inline auto min(Comp comp) {
+  auto run = [comp](auto &&cont) {
+    using value_type = remove_cr_t<decltype(*std::begin(cont))>;
+    auto result = detail::slot<value_type>{};
+    detail::for_each_segment(cont, [&result, &comp](auto first, auto last) {
+      auto it = std::min_element(first, last, comp);
+      if (it != last && (!result || comp(*it, *result))) result.emplace(*it);
+    });
+    return *result;
+  };
+  auto make = [comp](auto tag) {
+    using value_type = typename decltype(tag)::type;
+    auto step = [comp](auto &best, auto &&x) {
+      if (!best || comp(x, *best)) best = x;
+    };
+    return detail::accumulator{std::optional<value_type>{}, step, [](auto &best) { return *best; }};
+  };
+  return operation{detail::terminal{run, make}};
+}
+
+constexpr inline auto min() {
+  return min(func::less);
+}
+
+template<typename Comp>
+constexpr inline auto max(Comp comp) {
+  auto run = [comp](auto &&cont) {
+    using value_type = remove_cr_t<decltype(*std::begin(cont))>;
+    auto result = detail::slot<value_type>{};
+    detail::for_each_segment(cont, [&result, &comp](auto first, auto last) {
+      auto it = std::max_element(first, last, comp);
+      if (it != last && (!result || comp(*result, *it))) result.emplace(*it);
+    });
+    return *result;
+  };
+  auto make = [comp](auto tag) {
+    using value_type = typename decltype(tag)::type;
+    auto step = [comp](auto &best, auto &&x) {
+      if (!best || comp(*best, x)) best = x;
+    };
+    return detail::accumulator{std::optional<value_type>{}, step, [](auto &best) { return *best; }};
+  };
+  return operation{detail::terminal{run, make}};
+}
+
+constexpr inline auto max() {
+  return max(func::less);
+}
+
+constexpr inline auto count() {
+  auto run = [](auto &&cont) {
+    auto n = std::ptrdiff_t{};
+    detail::for_each_segment(cont, [&n](auto first, auto last) { n += std::distance(first, last); });
+    return n;
+  };
+  auto make = [](auto) {
+    return detail::accumulator{std::ptrdiff_t{}, [](auto &n, auto &&) { ++n; }, [](auto &n) { return n; }};
+  };
+  return operation{detail::terminal{run, make}};
+}
+
+template<typename Pred>
+constexpr inline auto count(Pred pred) {
+  auto run = [pred](auto &&cont) {
+    auto n = std::ptrdiff_t{};
+    detail::for_each_segment(cont, [&n, &pred](auto first, auto last) {
+      for (; first != last; ++first) {
+        n += pred(*first) ? 1 : 0;
+      }
+    });
+    return n;
+  };
+  auto make = [pred](auto) {
+    return detail::accumulator{std::ptrdiff_t{}, [pred](auto &n, auto &&x) { n += pred(x) ? 1 : 0; }, [](auto &n) { return n; }};
+  };
+  return operation{detail::terminal{run, make}};
+}
+
+template<typename Pred>
+constexpr inline auto all(Pred pred) {
+  return operation{[pred](auto &&cont) {
+    auto result = true;
+    detail::for_each_segment(cont, [&result, &pred](auto first, auto last) {
+      for (; result && first != last; ++first) {
+        result = pred(*first);
+      }
+    });
+    return result;
   }};
 }
 
 template<typename Pred>
 constexpr inline auto any(Pred pred) {
   return operation{[pred](auto &&cont) {
-    return std::any_of(std::begin(cont), std::end(cont), pred);
+    auto result = false;
+    detail::for_each_segment(cont, [&result, &pred](auto first, auto last) {
+      for (; !result && first != last; ++first) {
+        result = pred(*first);
+      }
+    });
+    return result;
   }};
 }
 
 template<typename Pred>
 constexpr inline auto none(Pred pred) {
   return operation{[pred](auto &&cont) {
-    return std::none_of(std::begin(cont), std::end(cont), pred);
+    return !(cont | any(pred));
   }};
 }
 
-template<typename Iter, typename OtherIter>
+template<typename... Iters>
 struct concat_iter {
+  public:
+  using difference_type = std::ptrdiff_t;
+  using value_type = std::common_type_t<typename std::iterator_traits<Iters>::value_type...>;
+  using pointer = std::optional<value_type>;
+  using reference = value_type;
+  using iterator_category = std::input_iterator_tag;
+
   private:
-  Iter iter, iter_end;
-  OtherIter other_iter;
+  static constexpr auto n = sizeof...(Iters);
+
+  std::tuple<Iters...> iters, ends;
+  std::size_t segment;
+
+  // Skips exhausted segments, leaving the last one as the end position.
+  template<std::size_t I = 0>
+  void settle() {
+    if constexpr (I + 1 < n) {
+      if (segment == I) {
+        if (!(std::get<I>(iters) != std::get<I>(ends))) {
+          ++segment;
+        } else {
+          return;
+        }
+      }
+      settle<I + 1>();
+    }
+  }
+
+  template<std::size_t I = 0>
+  value_type deref() {
+    if constexpr (I + 1 < n) {
+      if (segment != I) return deref<I + 1>();
+    }
+    return *std::get<I>(iters);
+  }
+
+  template<std::size_t I = 0>
+  void increment() {
+    if constexpr (I + 1 < n) {
+      if (segment != I) return increment<I + 1>();
+    }
+    ++std::get<I>(iters);
+  }
+
+  template<std::size_t I = 0>
+  bool equal(const concat_iter &it) {
+    if constexpr (I + 1 < n) {
+      if (segment != I) return equal<I + 1>(it);
+    }
+    return std::get<I>(iters) == std::get<I>(it.iters);
+  }
+
+  public:
+  constexpr concat_iter(std::tuple<Iters...> iters, std::tuple<Iters...> ends, std::size_t segment)
+      : iters(std::move(iters)), ends(std::move(ends)), segment(segment) {
+    settle();
+  }
+
+  value_type operator*() {
+    return deref();
+  }
+
+  concat_iter &operator++() {
+    increment();
+    settle();
+    return *this;
+  }
+
+  pointer operator->() {
+    return **this;
+  }
+
+  concat_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator!=(const concat_iter &it) {
+    return !(*this == it);
+  }
+
+  bool operator==(const concat_iter &it) {
+    return segment == it.segment && equal(it);
+  }
+};
+
+template<typename Iter, typename... Holders>
+struct concat_sequence {
+  public:
+  using const_iterator = concat_iter<Iter, decltype(std::begin(std::declval<Holders>().get()))...>;
+  using iterator = const_iterator;
+  using value_type = typename iterator::value_type;
+  using pointer = typename iterator::pointer;
+  using reference = typename iterator::reference;
+  using const_reference = const reference;
+  using const_pointer = const pointer;
+  using difference_type = typename iterator::difference_type;
+
+  // Lets terminal operations walk each segment with its own loop.
+  static constexpr bool segmented = true;
+
+  private:
+  Iter first, last;
+  std::tuple<Holders...> others;
+
+  public:
+  concat_sequence(Iter first, Iter last, std::tuple<Holders...> others)
+      : first(first), last(last), others(std::move(others)) {}
+
+  iterator begin() const {
+    auto begins = std::apply([this](auto &...h) { return std::make_tuple(first, std::begin(h.get())...); }, others);
+    auto ends = std::apply([this](auto &...h) { return std::make_tuple(last, std::end(h.get())...); }, others);
+    return {begins, ends, 0};
+  }
+
+  iterator end() const {
+    auto ends = std::apply([this](auto &...h) { return std::make_tuple(last, std::end(h.get())...); }, others);
+    return {ends, ends, sizeof...(Holders)};
+  }
+
+  template<typename Fn>
+  void segments(Fn &&fn) const {
+    fn(first, last);
+    std::apply([&fn](auto &...h) { (..., fn(std::begin(h.get()), std::end(h.get()))); }, others);
+  }
+};
+
+// Appends other ranges after the piped one. Lvalue ranges are borrowed and
+// must outlive the result, rvalue ranges are owned.
+template<typename... Rs>
+constexpr inline auto concat(Rs &&...others) {
+  return operation{[others = std::make_tuple(detail::holder<Rs>(std::forward<Rs>(others))...)](auto &&cont) {
+    return concat_sequence{std::begin(cont), std::end(cont), others};
+  }};
+}
+
+} // namespace whl::op
+
+namespace whl::detail {
+
+template<typename R>
+inline holder<R> hold(R &&range) {
+  return holder<R>(std::forward<R>(range));
+}
+
+// Tournament over k sorted runs. `tree[0]` is the index of the run holding the
+// smallest head, each inner node keeps the loser of the match played there,
+// and run i sits at leaf k + i. Popping the winner replays only its path to
+// the root, so every element costs log k comparisons. Ties go to the earlier
+// run, which keeps the merge stable.
+template<typename Iter, typename Comp, typename Owner>
+struct merge_state {
+  Owner owner;
+  Comp comp;
+  std::vector<std::pair<Iter, Iter>> runs{};
+  std::vector<std::size_t> tree{};
+
+  merge_state(Owner owner, Comp comp) : owner(std::move(owner)), comp(std::move(comp)) {}
+
+  bool exhausted(std::size_t i) {
+    return !(runs[i].first != runs[i].second);
+  }
+
+  bool beats(std::size_t i, std::size_t j) {
+    if (exhausted(i)) return false;
+    if (exhausted(j)) return true;
+    if (comp(*runs[i].first, *runs[j].first)) return true;
+    return !comp(*runs[j].first, *runs[i].first) && i < j;
+  }
+
+  void build() {
+    auto k = runs.size();
+    tree.assign(std::max<std::size_t>(k, 1), 0);
+    if (k <= 1) return;
+    auto winners = std::vector<std::size_t>(2 * k);
+    for (std::size_t i = 0; i < k; ++i) {
+      winners[k + i] = i;
+    }
+    for (auto node = k - 1; node >= 1; --node) {
+      auto l = winners[2 * node], r = winners[2 * node + 1];
+      auto left_wins = beats(l, r);
+      winners[node] = left_wins ? l : r;
+      tree[node] = left_wins ? r : l;
+    }
+    tree[0] = winners[1];
+  }
+
+  bool done() {
+    return runs.empty() || exhausted(tree[0]);
+  }
+
+  decltype(auto) front() {
+    return *runs[tree[0]].first;
+  }
+
+  void pop() {
+    auto winner = tree[0];
+    ++runs[winner].first;
+    for (auto node = (winner + runs.size()) / 2; node >= 1; node /= 2) {
+      if (beats(tree[node], winner)) std::swap(tree[node], winner);
+    }
+    tree[0] = winner;
+  }
+};
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+// Single-pass iterator over a shared state that exposes `front()`, `pop()`
+// and `done()`, as the k-way merge and intersection do.
+template<typename State>
+struct run_iter {
+  public:
+  using reference = decltype(std::declval<State &>().front());
+  using value_type = remove_cr_t<reference>;
+  using pointer = std::optional<value_type>;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+
+  private:
+  static constexpr auto npos = static_cast<std::size_t>(-1);
+
+  std::shared_ptr<State> state;
+  std::size_t index;
+
+  public:
+  run_iter(std::shared_ptr<State> state, std::size_t index) : state(std::move(state)), index(index) {
+    if (index != npos && this->state->done()) this->index = npos;
+  }
+
+  reference operator*() const {
+    return state->front();
+  }
+
+  pointer operator->() const {
+    return **this;
+  }
+
+  run_iter &operator++() {
+    state->pop();
+    index = state->done() ? npos : index + 1;
+    return *this;
+  }
+
+  run_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator!=(const run_iter &it) const {
+    return !(*this == it);
+  }
+
+  bool operator==(const run_iter &it) const {
+    return index == it.index;
+  }
+};
+
+} // namespace whl::op
+
+namespace whl::detail {
+
+// Creates a `State<Iter, Comp, Owner>` whose runs are added by `runs(state)`.
+template<template<typename, typename, typename> typename State, typename Iter, typename Comp, typename Owner, typename Runs>
+inline auto make_runs(Comp comp, Owner owner, Runs runs) {
+  auto state = std::make_shared<State<Iter, Comp, Owner>>(std::move(owner), std::move(comp));
+  runs(*state);
+  state->build();
+  return sequence{op::run_iter{state, 0}, op::run_iter{state, static_cast<std::size_t>(-1)}};
+}
+
+// Same for the ranges of a range of ranges. Ranges that are produced on the
+// fly are collected first, so that they stay alive.
+template<template<typename, typename, typename> typename State, typename Comp, typename C>
+inline auto nested_runs(Comp comp, C &&cont) {
+  using outer_reference = iter_reference_t<decltype(std::begin(cont))>;
+  auto runs = [](auto &state) {
+    for (auto &&run : std::get<0>(state.owner).get()) {
+      state.runs.emplace_back(std::begin(run), std::end(run));
+    }
+  };
+  if constexpr (std::is_lvalue_reference_v<outer_reference>) {
+    using iter_type = decltype(std::begin(std::declval<outer_reference>()));
+    return make_runs<State, iter_type>(comp, std::make_tuple(hold(std::forward<C>(cont))), runs);
+  } else {
+    using run_type = remove_cr_t<outer_reference>;
+    auto stored = std::vector<run_type>(std::begin(cont), std::end(cont));
+    using iter_type = decltype(std::begin(std::declval<run_type &>()));
+    return make_runs<State, iter_type>(comp, std::make_tuple(hold(std::move(stored))), runs);
+  }
+}
+
+// Type-erased cursor over a run, for merging ranges whose iterators differ.
+// A default-constructed cursor is the end of every run.
+template<typename Reference>
+struct run_cursor {
+  public:
+  using reference = Reference;
+  using value_type = remove_cr_t<reference>;
+  using pointer = std::optional<value_type>;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+
+  private:
+  struct base {
+    virtual ~base() = default;
+    virtual bool done() const = 0;
+    virtual reference get() const = 0;
+    virtual void next() = 0;
+  };
+
+  template<typename Iter>
+  struct impl final : base {
+    Iter first, last;
+
+    impl(Iter first, Iter last) : first(std::move(first)), last(std::move(last)) {}
+
+    bool done() const override {
+      return !(first != last);
+    }
+
+    reference get() const override {
+      return *first;
+    }
+
+    void next() override {
+      ++first;
+    }
+  };
+
+  std::unique_ptr<base> run{};
+
+  public:
+  run_cursor() = default;
+
+  template<typename Iter>
+  run_cursor(Iter first, Iter last) : run(std::make_unique<impl<Iter>>(std::move(first), std::move(last))) {}
+
+  reference operator*() const {
+    return run->get();
+  }
+
+  run_cursor &operator++() {
+    run->next();
+    return *this;
+  }
+
+  bool operator!=(const run_cursor &) const {
+    return run && !run->done();
+  }
+};
+
+template<typename R, typename = void>
+struct const_iter {
+  using type = void;
+};
+
+template<typename R>
+struct const_iter<R, std::void_t<decltype(std::begin(std::declval<const R &>()))>> {
+  using type = decltype(std::begin(std::declval<const R &>()));
+};
+
+template<typename R>
+using begin_t = decltype(std::begin(std::declval<R &>()));
+
+// Iterator type the runs of a merge are stored as: the one of all ranges,
+// else their common const iterator, else a cursor yielding the common
+// reference, or the common value type if the references differ.
+template<typename R, typename... Rs>
+using merge_iter_t = std::conditional_t<
+    (std::is_same_v<begin_t<R>, begin_t<Rs>> && ...), begin_t<R>,
+    std::conditional_t<
+        !std::is_void_v<typename const_iter<R>::type> && (std::is_same_v<typename const_iter<R>::type, typename const_iter<Rs>::type> && ...),
+        typename const_iter<R>::type,
+        run_cursor<std::conditional_t<(std::is_same_v<iter_reference_t<begin_t<R>>, iter_reference_t<begin_t<Rs>>> && ...),
+                                      iter_reference_t<begin_t<R>>,
+                                      std::common_type_t<remove_cr_t<iter_reference_t<begin_t<R>>>, remove_cr_t<iter_reference_t<begin_t<Rs>>>...>>>>>;
+
+template<typename Iter, typename R>
+inline std::pair<Iter, Iter> make_run(R &range) {
+  if constexpr (std::is_constructible_v<Iter, begin_t<R>, begin_t<R>>) {
+    return {Iter(std::begin(range), std::end(range)), Iter()};
+  } else {
+    return {Iter(std::begin(range)), Iter(std::end(range))};
+  }
+}
+
+template<typename Comp, typename... Rs>
+constexpr inline auto merge(Comp comp, Rs &&...others) {
+  return op::operation{[comp, others = std::make_tuple(holder<Rs>(std::forward<Rs>(others))...)](auto &&cont) {
+    using iter_type = merge_iter_t<std::remove_reference_t<decltype(cont)>, std::remove_reference_t<Rs>...>;
+    auto owner = std::tuple_cat(std::make_tuple(hold(std::forward<decltype(cont)>(cont))), others);
+    return make_runs<merge_state, iter_type>(comp, std::move(owner), [](auto &state) {
+      std::apply([&state](auto &...h) { (..., state.runs.push_back(make_run<iter_type>(h.get()))); }, state.owner);
+    });
+  }};
+}
+
+template<typename Tuple, std::size_t... I>
+constexpr inline auto merge_split(Tuple &&args, std::index_sequence<I...>) {
+  return merge(std::get<sizeof...(I)>(args), std::get<I>(std::move(args))...);
+}
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+// Lazily merges the piped sorted range with other sorted ranges, in the order
+// of `std::less` or of a comparator passed as the last argument. Equal
+// elements keep their input order. Ranges of one container type are walked
+// by their (const) iterators, others through a type-erased cursor; rvalue
+// ranges are owned, lvalue ones borrowed.
+template<typename... Args>
+constexpr inline auto merge(Args &&...args) {
+  if constexpr (sizeof...(Args) == 0 || is_iterable_v<std::tuple_element_t<sizeof...(Args) - 1, std::tuple<Args...>>>) {
+    return detail::merge(std::less<>{}, std::forward<Args>(args)...);
+  } else {
+    return detail::merge_split(std::forward_as_tuple(std::forward<Args>(args)...), std::make_index_sequence<sizeof...(Args) - 1>());
+  }
+}
+
+// Lazily merges the sorted ranges of the piped range of ranges.
+template<typename Comp = std::less<>>
+constexpr inline auto merge_all(Comp comp = {}) {
+  return operation{[comp](auto &&cont) {
+    return detail::nested_runs<detail::merge_state>(comp, std::forward<decltype(cont)>(cont));
+  }};
+}
+
+} // namespace whl::op
+
+namespace whl::detail {
+
+// First position in [first, last) not ordered before `value`. Random-access
+// ranges are probed at exponentially growing distances and then bisected, so
+// the cost is logarithmic in the distance skipped.
+template<typename Iter, typename Val, typename Comp>
+inline Iter gallop(Iter first, Iter last, const Val &value, Comp &comp) {
+  if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>) {
+    auto n = last - first;
+    auto bound = decltype(n){1};
+    while (bound < n && comp(first[bound], value)) {
+      bound *= 2;
+    }
+    return std::lower_bound(first + bound / 2, first + std::min(bound + 1, n), value, comp);
+  } else {
+    while (first != last && comp(*first, value)) {
+      ++first;
+    }
+    return first;
+  }
+}
+
+// Vector iterators and pointers over 32 or 64-bit integers, which the SIMD
+// intersection can read as arrays.
+template<typename Iter>
+constexpr bool is_int_block_iter() {
+  using value_type = typename std::iterator_traits<Iter>::value_type;
+  if constexpr (!std::is_integral_v<value_type> || (sizeof(value_type) != 4 && sizeof(value_type) != 8)) {
+    return false;
+  } else {
+    return std::is_pointer_v<Iter> || std::is_same_v<Iter, typename std::vector<value_type>::iterator>
+        || std::is_same_v<Iter, typename std::vector<value_type>::const_iterator>;
+  }
+}
+
+enum class set_kind { intersection, union_of, difference };
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+// Walks two sorted ranges with the semantics of the `std::set_*` algorithms,
+// duplicates included. When one range is more than 32 times longer than the
+// other, the longer one is searched by galloping instead of stepping, and
+// intersections of integer arrays skip disjoint blocks with SIMD compares.
+template<detail::set_kind Kind, typename Iter1, typename Iter2, typename Comp>
+struct set_iter {
+  private:
+  using reference1 = detail::iter_reference_t<Iter1>;
+  using reference2 = detail::iter_reference_t<Iter2>;
+  using category1 = typename std::iterator_traits<Iter1>::iterator_category;
+  using category2 = typename std::iterator_traits<Iter2>::iterator_category;
+
+  static constexpr bool random_access = std::is_base_of_v<std::random_access_iterator_tag, category1>
+                                     && std::is_base_of_v<std::random_access_iterator_tag, category2>;
+  static constexpr bool simd = Kind == detail::set_kind::intersection && detail::is_int_block_iter<Iter1>() && detail::is_int_block_iter<Iter2>()
+                            && std::is_same_v<remove_cr_t<reference1>, remove_cr_t<reference2>>
+                            && (std::is_same_v<Comp, std::less<>> || std::is_same_v<Comp, std::less<remove_cr_t<reference1>>>);
+
+  public:
+  using reference = std::conditional_t<Kind != detail::set_kind::union_of || std::is_same_v<reference1, reference2>, reference1,
+                                       remove_cr_t<reference1>>;
+  using value_type = remove_cr_t<reference>;
+  using pointer = std::optional<value_type>;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::conditional_t<std::is_base_of_v<std::forward_iterator_tag, category1>
+                                                   && std::is_base_of_v<std::forward_iterator_tag, category2>,
+                                               std::forward_iterator_tag, std::input_iterator_tag>;
+
+  private:
+  enum { from_a, from_b, from_both };
+
+  Iter1 a, a_last;
+  Iter2 b, b_last;
+  Comp comp;
+  bool skewed{};
+  int from{};
+
+  template<typename Iter, typename Val>
+  Iter seek(Iter first, Iter last, const Val &value) {
+    if (skewed) return detail::gallop(first, last, value, comp);
+    while (first != last && comp(*first, value)) {
+      ++first;
+    }
+    return first;
+  }
+
+  void skip_disjoint() {
+    if constexpr (simd) {
+      if (skewed || !(a != a_last) || !(b != b_last)) return;
+      using value_type = remove_cr_t<reference1>;
+      const value_type *pa = &*a, *pb = &*b;
+      auto qa = pa, qb = pb;
+      simd::skip_disjoint(qa, pa + (a_last - a), qb, pb + (b_last - b));
+      a += qa - pa;
+      b += qb - pb;
+    }
+  }
 
-  public:
-  using difference_type = typename Iter::difference_type;
-  using value_type = typename Iter::value_type;
-  using pointer = std::optional<value_type>;
-  using reference = typename Iter::reference;
-  using iterator_category = std::input_iterator_tag;
+  void settle() {
+    if constexpr (Kind == detail::set_kind::intersection) {
+      for (;;) {
+        skip_disjoint();
+        if (!(a != a_last) || !(b != b_last)) {
+          a = a_last;
+          b = b_last;
+          return;
+        }
+        if (comp(*a, *b)) {
+          a = seek(a, a_last, *b);
+        } else if (comp(*b, *a)) {
+          b = seek(b, b_last, *a);
+        } else {
+          return;
+        }
+      }
+    } else if constexpr (Kind == detail::set_kind::difference) {
+      for (;;) {
+        if (!(a != a_last)) {
+          b = b_last;
+          return;
+        }
+        if (!(b != b_last) || comp(*a, *b)) return;
+        if (comp(*b, *a)) {
+          b = seek(b, b_last, *a);
+        } else {
+          ++a;
+          ++b;
+        }
+      }
+    } else {
+      if (!(a != a_last)) {
+        from = from_b;
+      } else if (!(b != b_last) || comp(*a, *b)) {
+        from = from_a;
+      } else {
+        from = comp(*b, *a) ? from_b : from_both;
+      }
+    }
+  }
 
   public:
-  constexpr concat_iter(Iter iter, Iter end, OtherIter other)
-      : iter(iter), iter_end(end), other_iter(other){};
+  set_iter(Iter1 a, Iter1 a_last, Iter2 b, Iter2 b_last, Comp comp)
+      : a(a), a_last(a_last), b(b), b_last(b_last), comp(comp) {
+    if constexpr (random_access) {
+      auto n = a_last - a, m = b_last - b;
+      skewed = std::max(n, m) > 32 * std::min(n, m);
+    }
+    settle();
+  }
 
-  constexpr concat_iter(Iter end, OtherIter other_end)
-      : iter(end), iter_end(end), other_iter(other_end){};
+  reference operator*() const {
+    if constexpr (Kind == detail::set_kind::union_of) {
+      if (from == from_b) return *b;
+    }
+    return *a;
+  }
 
-  constexpr value_type operator*() {
-    return iter != iter_end ? *iter : *other_iter;
+  pointer operator->() const {
+    return **this;
   }
 
-  concat_iter &operator++() {
-    if (iter != iter_end) {
-      ++iter;
+  set_iter &operator++() {
+    if constexpr (Kind == detail::set_kind::union_of) {
+      if (from != from_b) ++a;
+      if (from != from_a) ++b;
+    } else if constexpr (Kind == detail::set_kind::intersection) {
+      ++a;
+      ++b;
     } else {
-      ++other_iter;
+      ++a;
     }
+    settle();
     return *this;
   }
 
-  pointer operator->() {
-    return **this;
-  }
-
-  concat_iter operator++(int) {
+  set_iter operator++(int) {
     auto it = *this;
     ++*this;
     return it;
   }
 
-  bool operator!=(const concat_iter &it) {
+  bool operator!=(const set_iter &it) {
     return !(*this == it);
   }
 
-  bool operator==(const concat_iter &it) {
-    return iter == it.iter && other_iter == it.other_iter;
+  bool operator==(const set_iter &it) {
+    return !(a != it.a) && !(b != it.b);
   }
 };
 
-template<typename Iter, typename C>
-struct concat_sequence {
+template<detail::set_kind Kind, typename Holder1, typename Holder2, typename Comp>
+struct set_sequence {
   public:
-  using const_iterator = concat_iter<Iter, typename C::const_iterator>;
+  using const_iterator = set_iter<Kind, decltype(std::begin(std::declval<Holder1>().get())),
+                                  decltype(std::begin(std::declval<Holder2>().get())), Comp>;
   using iterator = const_iterator;
   using value_type = typename iterator::value_type;
   using pointer = typename iterator::pointer;
@@ -642,26 +1991,251 @@ struct concat_sequence {
   using difference_type = typename iterator::difference_type;
 
   private:
-  C other;
-  Iter first, last;
+  Holder1 first;
+  Holder2 second;
+  Comp comp;
 
   public:
-  concat_sequence(Iter first, Iter last, C other)
-      : first(first), last(last), other(std::move(other)) {}
+  set_sequence(Holder1 first, Holder2 second, Comp comp)
+      : first(std::move(first)), second(std::move(second)), comp(std::move(comp)) {}
 
   iterator begin() const {
-    return {first, last, std::begin(other)};
+    return {std::begin(first.get()), std::end(first.get()), std::begin(second.get()), std::end(second.get()), comp};
   }
 
   iterator end() const {
-    return {last, std::end(other)};
+    return {std::end(first.get()), std::end(first.get()), std::end(second.get()), std::end(second.get()), comp};
   }
 };
 
-template<typename C>
-constexpr inline auto concat(C other) {
-  return operation{[other](auto &&cont) {
-    return concat_sequence{std::begin(cont), std::end(cont), other};
+} // namespace whl::op
+
+namespace whl::detail {
+
+template<set_kind Kind, typename R, typename Comp>
+constexpr inline auto set_op(R &&other, Comp comp) {
+  return op::operation{[comp, other = holder<R>(std::forward<R>(other))](auto &&cont) {
+    auto first = hold(std::forward<decltype(cont)>(cont));
+    return op::set_sequence<Kind, decltype(first), holder<R>, Comp>{std::move(first), other, comp};
+  }};
+}
+
+// Intersection of k sorted runs: the head of one run is the candidate, every
+// other run gallops to it in turn, and a run that overshoots provides the next
+// candidate. The runs start in ascending length, so the shortest one drives.
+template<typename Iter, typename Comp, typename Owner>
+struct intersect_state {
+  Owner owner;
+  Comp comp;
+  std::vector<std::pair<Iter, Iter>> runs{};
+  std::size_t lead{};
+  bool ended{};
+
+  intersect_state(Owner owner, Comp comp) : owner(std::move(owner)), comp(std::move(comp)) {}
+
+  bool exhausted(std::size_t i) {
+    return !(runs[i].first != runs[i].second);
+  }
+
+  void settle() {
+    auto k = runs.size();
+    if (k == 0 || exhausted(lead)) {
+      ended = true;
+      return;
+    }
+    auto agreed = std::size_t{1};
+    for (auto i = (lead + 1) % k; agreed < k; i = (i + 1) % k) {
+      runs[i].first = gallop(runs[i].first, runs[i].second, *runs[lead].first, comp);
+      if (exhausted(i)) {
+        ended = true;
+        return;
+      }
+      if (comp(*runs[lead].first, *runs[i].first)) {
+        lead = i;
+        agreed = 1;
+      } else {
+        ++agreed;
+      }
+    }
+  }
+
+  void build() {
+    if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>) {
+      std::stable_sort(runs.begin(), runs.end(), [](auto &l, auto &r) { return l.second - l.first < r.second - r.first; });
+    }
+    settle();
+  }
+
+  bool done() {
+    return ended;
+  }
+
+  decltype(auto) front() {
+    return *runs[lead].first;
+  }
+
+  void pop() {
+    for (auto &&run : runs) {
+      ++run.first;
+    }
+    settle();
+  }
+};
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+// Lazy set operations of the piped sorted range with another one sorted by
+// the same `comp`. Rvalue ranges are owned, lvalue ones borrowed.
+template<typename R, typename Comp = std::less<>>
+constexpr inline auto set_intersection(R &&other, Comp comp = {}) {
+  return detail::set_op<detail::set_kind::intersection>(std::forward<R>(other), comp);
+}
+
+template<typename R, typename Comp = std::less<>>
+constexpr inline auto set_union(R &&other, Comp comp = {}) {
+  return detail::set_op<detail::set_kind::union_of>(std::forward<R>(other), comp);
+}
+
+template<typename R, typename Comp = std::less<>>
+constexpr inline auto set_difference(R &&other, Comp comp = {}) {
+  return detail::set_op<detail::set_kind::difference>(std::forward<R>(other), comp);
+}
+
+// Lazy intersection of the sorted ranges of the piped range of ranges, each
+// value appearing once per time it is in all of them.
+template<typename Comp = std::less<>>
+constexpr inline auto set_intersection_all(Comp comp = {}) {
+  return operation{[comp](auto &&cont) {
+    return detail::nested_runs<detail::intersect_state>(comp, std::forward<decltype(cont)>(cont));
+  }};
+}
+
+} // namespace whl::op
+
+namespace whl::detail {
+
+template<typename Iter>
+struct cache_state {
+  using value_type = remove_cr_t<iter_reference_t<Iter>>;
+
+  Iter iter, last;
+  std::deque<value_type> buffer{};
+
+  cache_state(Iter first, Iter last) : iter(first), last(last) {}
+
+  // Pulls upstream until element `i` is buffered, false if there is none.
+  bool fill(std::size_t i) {
+    while (buffer.size() <= i) {
+      if (!(iter != last)) return false;
+      buffer.push_back(*iter);
+      ++iter;
+    }
+    return true;
+  }
+};
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+template<typename Iter>
+struct cache_iter {
+  public:
+  using value_type = typename detail::cache_state<Iter>::value_type;
+  using pointer = const value_type *;
+  using reference = const value_type &;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  private:
+  static constexpr auto npos = static_cast<std::size_t>(-1);
+
+  std::shared_ptr<detail::cache_state<Iter>> state;
+  std::size_t index;
+
+  bool at_end() const {
+    return index == npos || !state->fill(index);
+  }
+
+  public:
+  cache_iter(std::shared_ptr<detail::cache_state<Iter>> state, std::size_t index)
+      : state(std::move(state)), index(index) {}
+
+  reference operator*() const {
+    state->fill(index);
+    return state->buffer[index];
+  }
+
+  pointer operator->() const {
+    return &**this;
+  }
+
+  cache_iter &operator++() {
+    ++index;
+    return *this;
+  }
+
+  cache_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator!=(const cache_iter &it) const {
+    return !(*this == it);
+  }
+
+  bool operator==(const cache_iter &it) const {
+    auto end = at_end();
+    return end == it.at_end() && (end || index == it.index);
+  }
+};
+
+// Buffers upstream elements the first time they are reached, so that any
+// number of later passes see them without re-running the lazy stages.
+constexpr inline auto cache() {
+  return operation{[](auto &&cont) {
+    auto state = std::make_shared<detail::cache_state<decltype(std::begin(cont))>>(std::begin(cont), std::end(cont));
+    return sequence{cache_iter{state, 0}, cache_iter{state, static_cast<std::size_t>(-1)}};
+  }};
+}
+
+constexpr inline auto memoize() {
+  return cache();
+}
+
+// Runs any number of accumulating terminals (fold, sum, reduce, average,
+// min, max, count) over a single traversal and returns their results as a
+// tuple, in argument order.
+template<typename... Ops>
+constexpr inline auto aggregate(Ops... ops) {
+  return operation{[ops...](auto &&cont) {
+    using value_type = remove_cr_t<decltype(*std::begin(cont))>;
+    auto accs = std::make_tuple(ops.template accumulator<value_type>()...);
+    detail::for_each_segment(cont, [&accs](auto first, auto last) {
+      for (; first != last; ++first) {
+        auto &&x = *first;
+        std::apply([&x](auto &...acc) { (..., acc(x)); }, accs);
+      }
+    });
+    return std::apply([](auto &...acc) { return std::tuple{acc.result()...}; }, accs);
+  }};
+}
+
+// Feeds the same elements to several sub-pipelines, each a callable taking
+// the range (any operation qualifies), and returns their results as a tuple.
+// Lazy inputs are cached first, so upstream stages run once.
+template<typename... Fns>
+constexpr inline auto tee(Fns... fns) {
+  return operation{[fns...](auto &&cont) {
+    if constexpr (detail::has_size<decltype(cont)>::value) {
+      return std::tuple{fns(cont)...};
+    } else {
+      auto cached = cont | cache();
+      return std::tuple{fns(cached)...};
+    }
   }};
 }
 
@@ -679,9 +2253,14 @@ struct chunk_iter {
   difference_type n;
 
   void advance(Iter &it) {
-    for (difference_type i = n; i > 0; --i) {
-      if (it == iter_end) break;
-      ++it;
+    using category = typename std::iterator_traits<Iter>::iterator_category;
+    if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
+      it += std::min(n, static_cast<difference_type>(iter_end - it));
+    } else {
+      for (difference_type i = n; i > 0; --i) {
+        if (it == iter_end) break;
+        ++it;
+      }
     }
   }
 
@@ -722,25 +2301,376 @@ struct chunk_iter {
   }
 };
 
+// Chunks of contiguous storage, as spans computed from the chunk index.
+template<typename T>
+struct span_chunk_iter {
+  public:
+  using difference_type = std::ptrdiff_t;
+  using value_type = span<T>;
+  using pointer = std::optional<value_type>;
+  using reference = value_type;
+  using iterator_category = std::random_access_iterator_tag;
+
+  private:
+  T *data;
+  difference_type size, n, index;
+
+  public:
+  constexpr span_chunk_iter(T *data, difference_type size, difference_type n, difference_type index)
+      : data(data), size(size), n(n), index(index) {}
+
+  constexpr value_type operator*() const {
+    auto offset = index * n;
+    return {data + offset, static_cast<std::size_t>(std::min(n, size - offset))};
+  }
+
+  constexpr value_type operator[](difference_type i) const {
+    return *(*this + i);
+  }
+
+  pointer operator->() const {
+    return **this;
+  }
+
+  constexpr span_chunk_iter &operator++() {
+    ++index;
+    return *this;
+  }
+
+  constexpr span_chunk_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  constexpr span_chunk_iter &operator--() {
+    --index;
+    return *this;
+  }
+
+  constexpr span_chunk_iter operator--(int) {
+    auto it = *this;
+    --*this;
+    return it;
+  }
+
+  constexpr span_chunk_iter &operator+=(difference_type i) {
+    index += i;
+    return *this;
+  }
+
+  constexpr span_chunk_iter &operator-=(difference_type i) {
+    index -= i;
+    return *this;
+  }
+
+  constexpr span_chunk_iter operator+(difference_type i) const {
+    auto it = *this;
+    return it += i;
+  }
+
+  constexpr span_chunk_iter operator-(difference_type i) const {
+    auto it = *this;
+    return it -= i;
+  }
+
+  constexpr difference_type operator-(const span_chunk_iter &it) const {
+    return index - it.index;
+  }
+
+  constexpr bool operator==(const span_chunk_iter &it) const {
+    return index == it.index;
+  }
+
+  constexpr bool operator!=(const span_chunk_iter &it) const {
+    return index != it.index;
+  }
+
+  constexpr bool operator<(const span_chunk_iter &it) const {
+    return index < it.index;
+  }
+
+  constexpr bool operator>(const span_chunk_iter &it) const {
+    return index > it.index;
+  }
+
+  constexpr bool operator<=(const span_chunk_iter &it) const {
+    return index <= it.index;
+  }
+
+  constexpr bool operator>=(const span_chunk_iter &it) const {
+    return index >= it.index;
+  }
+};
+
+// Splits into chunks of `n` elements. Contiguous containers yield spans and
+// random-access chunks, other ranges yield subsequences.
 template<typename Size>
 constexpr inline auto chunk(Size n) {
   assert(n > 0);
   return operation{[n](auto &&cont) {
-    return sequence{chunk_iter{std::begin(cont), std::end(cont), n}, chunk_iter{std::end(cont)}};
+    if constexpr (is_contiguous_v<std::remove_reference_t<decltype(cont)>>) {
+      auto size = static_cast<std::ptrdiff_t>(std::size(cont));
+      auto step = static_cast<std::ptrdiff_t>(n);
+      auto count = (size + step - 1) / step;
+      return sequence{span_chunk_iter{std::data(cont), size, step, 0}, span_chunk_iter{std::data(cont), size, step, count}};
+    } else {
+      return sequence{chunk_iter{std::begin(cont), std::end(cont), n}, chunk_iter{std::end(cont)}};
+    }
+  }};
+}
+
+} // namespace whl::op
+
+namespace whl::detail {
+
+template<bool Ordered, typename C, typename Fn>
+inline auto par_chunks(C &cont, std::ptrdiff_t n, Fn &fn, thread_pool &pool) {
+  using iter_type = decltype(std::begin(cont));
+  static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<iter_type>::iterator_category>,
+                "par_chunks needs a random-access range");
+  auto first = std::begin(cont);
+  auto size = static_cast<std::ptrdiff_t>(std::distance(first, std::end(cont)));
+  auto count = static_cast<std::size_t>((size + n - 1) / n);
+  auto chunk_at = [&cont, first, size, n](std::size_t i) {
+    auto offset = static_cast<std::ptrdiff_t>(i) * n;
+    auto len = std::min(n, size - offset);
+    if constexpr (is_contiguous_v<C>) {
+      return span{std::data(cont) + offset, static_cast<std::size_t>(len)};
+    } else {
+      return sequence{first + offset, first + offset + len};
+    }
+  };
+  using result_type = std::invoke_result_t<Fn &, decltype(chunk_at(0))>;
+  if constexpr (std::is_void_v<result_type>) {
+    parallel_for(count, [&fn, &chunk_at](std::size_t i) { fn(chunk_at(i)); }, pool);
+  } else if constexpr (Ordered) {
+    auto slots = std::vector<std::optional<result_type>>(count);
+    parallel_for(count, [&fn, &chunk_at, &slots](std::size_t i) { slots[i].emplace(fn(chunk_at(i))); }, pool);
+    auto results = std::vector<result_type>{};
+    results.reserve(count);
+    for (auto &&slot : slots) {
+      results.push_back(std::move(*slot));
+    }
+    return results;
+  } else {
+    auto results = std::vector<result_type>{};
+    results.reserve(count);
+    auto mutex = std::mutex{};
+    parallel_for(count, [&fn, &chunk_at, &results, &mutex](std::size_t i) {
+      auto result = fn(chunk_at(i));
+      auto lock = std::lock_guard{mutex};
+      results.push_back(std::move(result));
+    }, pool);
+    return results;
+  }
+}
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+// Calls `fn` concurrently on chunks of `n` elements of a random-access range
+// (spans when it is contiguous) and gathers the results in chunk order.
+template<typename Size, typename Fn>
+inline auto par_chunks(Size n, Fn fn, thread_pool &pool = default_pool()) {
+  assert(n > 0);
+  return operation{[n, fn, &pool](auto &&cont) {
+    return detail::par_chunks<true>(cont, static_cast<std::ptrdiff_t>(n), fn, pool);
+  }};
+}
+
+// Like `par_chunks`, with results gathered in completion order.
+template<typename Size, typename Fn>
+inline auto par_chunks_unordered(Size n, Fn fn, thread_pool &pool = default_pool()) {
+  assert(n > 0);
+  return operation{[n, fn, &pool](auto &&cont) {
+    return detail::par_chunks<false>(cont, static_cast<std::ptrdiff_t>(n), fn, pool);
+  }};
+}
+
+} // namespace whl::op
+
+namespace whl::detail {
+
+// `lo` to `hi` in equal steps. Values below or above the range fall into the
+// first or last bin, as do NaNs into the first; clamping with selects keeps
+// the index computation free of branches.
+struct uniform_bins {
+  double lo, scale, top;
+  std::size_t count;
+
+  uniform_bins(double lo, double hi, std::size_t count)
+      : lo(lo), scale(static_cast<double>(count) / (hi - lo)), top(static_cast<double>(count - 1)), count(count) {}
+
+  template<typename T>
+  std::uint32_t operator()(const T &x) const {
+    auto t = (static_cast<double>(x) - lo) * scale;
+    t = t > 0.0 ? t : 0.0;
+    t = t < top ? t : top;
+    return static_cast<std::uint32_t>(t);
+  }
+};
+
+// Bin i is [edges[i], edges[i + 1]), found by a branchless binary search;
+// out of range values are clamped like in `uniform_bins`.
+template<typename Val>
+struct edge_bins {
+  std::vector<Val> edges;
+  std::size_t count;
+
+  explicit edge_bins(std::vector<Val> edges) : edges(std::move(edges)), count(this->edges.size() - 1) {}
+
+  template<typename T>
+  std::uint32_t operator()(const T &x) const {
+    auto first = edges.data();
+    for (auto len = edges.size(); len > 1; len -= len / 2) {
+      first = first[len / 2] <= x ? first + len / 2 : first;
+    }
+    auto i = static_cast<std::size_t>(first - edges.data());
+    return static_cast<std::uint32_t>(i < count ? i : count - 1);
+  }
+};
+
+// Bin indices are computed a block at a time, then counted into interleaved
+// sub-histograms, so that runs of equal values do not make every increment
+// wait for the previous store to the same counter.
+template<typename Bins>
+struct histogram_counter {
+  static constexpr std::size_t ways = 4;
+  static constexpr std::size_t block = 256;
+
+  const Bins &bins;
+  std::vector<std::size_t> counts;
+  std::uint32_t index[block];
+  std::size_t fill{};
+
+  explicit histogram_counter(const Bins &bins) : bins(bins), counts(ways * bins.count) {}
+
+  void flush() {
+    auto n = bins.count;
+    auto k = std::size_t{};
+    for (; k + ways <= fill; k += ways) {
+      ++counts[index[k]];
+      ++counts[n + index[k + 1]];
+      ++counts[2 * n + index[k + 2]];
+      ++counts[3 * n + index[k + 3]];
+    }
+    for (; k < fill; ++k) {
+      ++counts[index[k]];
+    }
+    fill = 0;
+  }
+
+  template<typename T>
+  void operator()(const T &x) {
+    index[fill] = bins(x);
+    if (++fill == block) flush();
+  }
+
+  template<typename T>
+  void push(const T *first, const T *last) {
+    while (first != last) {
+      auto n = std::min(block - fill, static_cast<std::size_t>(last - first));
+      for (std::size_t k = 0; k < n; ++k) {
+        index[fill + k] = bins(first[k]);
+      }
+      fill += n;
+      first += n;
+      if (fill == block) flush();
+    }
+  }
+
+  std::vector<std::size_t> result() {
+    flush();
+    auto n = bins.count;
+    auto merged = std::vector<std::size_t>(counts.begin(), counts.begin() + static_cast<std::ptrdiff_t>(n));
+    for (std::size_t way = 1; way < ways; ++way) {
+      for (std::size_t i = 0; i < n; ++i) {
+        merged[i] += counts[way * n + i];
+      }
+    }
+    return merged;
+  }
+};
+
+// Large contiguous ranges are counted in parallel chunks with one histogram
+// each, which are then summed in parallel stripes of bins.
+template<typename C, typename Bins>
+inline std::vector<std::size_t> histogram(C &cont, const Bins &bins, thread_pool &pool) {
+  constexpr auto grain = std::size_t{1} << 16;
+  if constexpr (is_contiguous_v<C>) {
+    auto first = std::data(cont);
+    auto size = static_cast<std::size_t>(std::size(cont));
+    auto chunks = std::min(pool.size() + 1, size / grain);
+    if (chunks <= 1) {
+      auto counter = histogram_counter<Bins>{bins};
+      counter.push(first, first + size);
+      return counter.result();
+    }
+    auto partials = std::vector<std::vector<std::size_t>>(chunks);
+    parallel_for(chunks, [first, size, chunks, &bins, &partials](std::size_t i) {
+      auto counter = histogram_counter<Bins>{bins};
+      counter.push(first + size * i / chunks, first + size * (i + 1) / chunks);
+      partials[i] = counter.result();
+    }, pool);
+    constexpr auto stripe = std::size_t{1} << 12;
+    auto result = std::move(partials[0]);
+    parallel_for((bins.count + stripe - 1) / stripe, [&result, &partials, &bins](std::size_t s) {
+      auto last = std::min(bins.count, (s + 1) * stripe);
+      for (std::size_t c = 1; c < partials.size(); ++c) {
+        for (auto i = s * stripe; i < last; ++i) {
+          result[i] += partials[c][i];
+        }
+      }
+    }, pool);
+    return result;
+  } else {
+    auto counter = histogram_counter<Bins>{bins};
+    for_each_segment(cont, [&counter](auto first, auto last) {
+      for (; first != last; ++first) {
+        counter(*first);
+      }
+    });
+    return counter.result();
+  }
+}
+
+} // namespace whl::detail
+
+namespace whl::op {
+
+// Counts of the elements in `nbins` equal bins spanning [lo, hi). Elements out
+// of the range are counted in the first or last bin.
+template<typename Val>
+inline auto histogram(Val lo, Val hi, std::size_t nbins, thread_pool &pool = default_pool()) {
+  assert(nbins > 0 && lo < hi);
+  return operation{[bins = detail::uniform_bins(static_cast<double>(lo), static_cast<double>(hi), nbins), &pool](auto &&cont) {
+    return detail::histogram(cont, bins, pool);
+  }};
+}
+
+// Counts of the elements in the bins delimited by the sorted `edges`, bin i
+// being [edges[i], edges[i + 1]).
+template<typename Val>
+inline auto histogram(std::vector<Val> edges, thread_pool &pool = default_pool()) {
+  assert(edges.size() >= 2);
+  return operation{[bins = detail::edge_bins<Val>(std::move(edges)), &pool](auto &&cont) {
+    return detail::histogram(cont, bins, pool);
   }};
 }
 
 constexpr inline auto print() {
-  return operation{[](auto &&val) {
+  return operation{[](auto &&val) -> detail::pass_t<decltype(val)> {
     whl::print(val);
-    return val;
+    return std::forward<decltype(val)>(val);
   }};
 }
 
 constexpr inline auto println() {
-  return operation{[](auto &&val) {
+  return operation{[](auto &&val) -> detail::pass_t<decltype(val)> {
     whl::println(val);
-    return val;
+    return std::forward<decltype(val)>(val);
   }};
 }
 
@@ -0,0 +1,148 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_PARALLEL_HPP
+#define WHEEL_WHL_PARALLEL_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace whl {
+
+struct thread_pool {
+  private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping = false;
+
+  void work() {
+    for (;;) {
+      auto task = std::function<void()>{};
+      {
+        auto lock = std::unique_lock{mutex};
+        cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  public:
+  explicit thread_pool(std::size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+
+  thread_pool(const thread_pool &) = delete;
+
+  ~thread_pool() {
+    {
+      auto lock = std::lock_guard{mutex};
+      stopping = true;
+    }
+    cv.notify_all();
+    for (auto &&worker : workers) {
+      worker.join();
+    }
+  }
+
+  std::size_t size() const noexcept {
+    return workers.size();
+  }
+
+  template<typename Fn>
+  auto submit(Fn fn) {
+    using result_type = std::invoke_result_t<Fn>;
+    auto task = std::make_shared<std::packaged_task<result_type()>>(std::move(fn));
+    auto future = task->get_future();
+    {
+      auto lock = std::lock_guard{mutex};
+      tasks.emplace_back([task] { (*task)(); });
+    }
+    cv.notify_one();
+    return future;
+  }
+};
+
+inline thread_pool &default_pool() {
+  static auto pool = thread_pool{};
+  return pool;
+}
+
+// Runs `fn(i)` for every i in [0, n) on the pool, with the calling thread
+// taking indices too. Only claimed indices are waited for, so calling this
+// from inside a pool task cannot deadlock on queued helpers.
+template<typename Fn>
+inline void parallel_for(std::size_t n, Fn &&fn, thread_pool &pool = default_pool()) {
+  if (n == 0) return;
+  struct state {
+    std::atomic<std::size_t> next{0};
+    std::size_t done{0};
+    std::exception_ptr error{};
+    std::mutex mutex{};
+    std::condition_variable cv{};
+    std::remove_reference_t<Fn> *fn;
+  };
+  auto st = std::make_shared<state>();
+  st->fn = &fn;
+  auto run = [n](state &st) {
+    for (auto i = st.next++; i < n; i = st.next++) {
+      auto error = std::exception_ptr{};
+      try {
+        (*st.fn)(i);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      auto lock = std::lock_guard{st.mutex};
+      if (error && !st.error) st.error = error;
+      if (++st.done == n) st.cv.notify_all();
+    }
+  };
+  auto helpers = std::min(n, pool.size()) - (n <= pool.size() ? 1 : 0);
+  for (std::size_t i = 0; i < helpers; ++i) {
+    pool.submit([st, run] { run(*st); });
+  }
+  run(*st);
+  auto lock = std::unique_lock{st->mutex};
+  st->cv.wait(lock, [&st, n] { return st->done == n; });
+  if (st->error) std::rethrow_exception(st->error);
+}
+
+} // namespace whl
+
+#endif // WHEEL_WHL_PARALLEL_HPP
@@ -0,0 +1,620 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_PATTERN_HPP
+#define WHEEL_WHL_PATTERN_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <regex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "whl/simd.hpp"
+
+namespace whl::str {
+
+namespace detail {
+
+using byte_set = std::bitset<256>;
+
+// Thrown while compiling a pattern the automaton does not handle.
+struct unsupported_pattern {};
+
+struct regex_node {
+  enum kind_t { empty, bytes, concat, alternate, repeat } kind;
+  int left = -1, right = -1;
+  std::size_t set = 0;
+  int min = 0, max = -1;
+};
+
+// Recursive descent parser for the ECMAScript subset without captures,
+// assertions other than a leading `^` and a trailing `$`, backreferences
+// and lazy quantifiers.
+struct regex_parser {
+  std::string_view src;
+  bool icase;
+  std::size_t pos = 0;
+  int depth = 0;
+  bool anchored_start = false, anchored_end = false;
+  std::vector<regex_node> nodes{};
+  std::vector<byte_set> sets{};
+
+  int add(regex_node node) {
+    nodes.push_back(node);
+    return static_cast<int>(nodes.size() - 1);
+  }
+
+  static byte_set fold(byte_set set) {
+    for (auto ch = 'a'; ch <= 'z'; ++ch) {
+      auto upper = static_cast<unsigned char>(ch - 'a' + 'A');
+      if (set[static_cast<unsigned char>(ch)] || set[upper]) {
+        set.set(static_cast<unsigned char>(ch));
+        set.set(upper);
+      }
+    }
+    return set;
+  }
+
+  int add_set(byte_set set) {
+    sets.push_back(icase ? fold(set) : set);
+    return add({regex_node::bytes, -1, -1, sets.size() - 1});
+  }
+
+  static byte_set single(unsigned char ch) {
+    auto set = byte_set{};
+    set.set(ch);
+    return set;
+  }
+
+  static byte_set range(unsigned char first, unsigned char last) {
+    auto set = byte_set{};
+    for (auto ch = static_cast<unsigned>(first); ch <= last; ++ch) set.set(ch);
+    return set;
+  }
+
+  bool at(char ch) const {
+    return pos < src.size() && src[pos] == ch;
+  }
+
+  int parse() {
+    if (at('^')) {
+      anchored_start = true;
+      ++pos;
+    }
+    auto root = parse_alternate();
+    if (pos != src.size()) throw unsupported_pattern{};
+    if ((anchored_start || anchored_end) && nodes[static_cast<std::size_t>(root)].kind == regex_node::alternate) throw unsupported_pattern{};
+    return root;
+  }
+
+  int parse_alternate() {
+    auto left = parse_concat();
+    while (at('|')) {
+      ++pos;
+      left = add({regex_node::alternate, left, parse_concat()});
+    }
+    return left;
+  }
+
+  int parse_concat() {
+    auto node = add({regex_node::empty});
+    while (pos < src.size() && src[pos] != '|' && src[pos] != ')') {
+      if (src[pos] == '$' && pos + 1 == src.size() && depth == 0) {
+        anchored_end = true;
+        ++pos;
+        break;
+      }
+      node = add({regex_node::concat, node, parse_repeat()});
+    }
+    return node;
+  }
+
+  int parse_number() {
+    if (pos >= src.size() || src[pos] < '0' || src[pos] > '9') throw unsupported_pattern{};
+    auto n = 0;
+    for (; pos < src.size() && src[pos] >= '0' && src[pos] <= '9'; ++pos) {
+      n = n * 10 + (src[pos] - '0');
+      if (n > 1000) throw unsupported_pattern{};
+    }
+    return n;
+  }
+
+  int parse_repeat() {
+    auto atom = parse_atom();
+    if (pos >= src.size()) return atom;
+    auto min = 0, max = -1;
+    switch (src[pos++]) {
+      case '*': break;
+      case '+': min = 1; break;
+      case '?': max = 1; break;
+      case '{':
+        min = max = parse_number();
+        if (at(',')) {
+          ++pos;
+          max = at('}') ? -1 : parse_number();
+        }
+        if (!at('}') || (max >= 0 && max < min)) throw unsupported_pattern{};
+        ++pos;
+        break;
+      default: --pos; return atom;
+    }
+    if (at('?') || at('*') || at('+') || at('{')) throw unsupported_pattern{};
+    auto node = regex_node{regex_node::repeat, atom};
+    node.min = min;
+    node.max = max;
+    return add(node);
+  }
+
+  int parse_atom() {
+    auto ch = src[pos++];
+    switch (ch) {
+      case '(': {
+        if (at('?')) {
+          if (pos + 1 >= src.size() || src[pos + 1] != ':') throw unsupported_pattern{};
+          pos += 2;
+        }
+        ++depth;
+        auto node = parse_alternate();
+        --depth;
+        if (!at(')')) throw unsupported_pattern{};
+        ++pos;
+        return node;
+      }
+      case '[': return add_set(parse_class());
+      case '.': return add_set(~(single('\n') | single('\r')));
+      case '\\': return add_set(parse_escape(false));
+      case ')':
+      case ']':
+      case '}':
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+      case '^':
+      case '$': throw unsupported_pattern{};
+      default: return add_set(single(static_cast<unsigned char>(ch)));
+    }
+  }
+
+  byte_set parse_escape(bool in_class) {
+    if (pos >= src.size()) throw unsupported_pattern{};
+    auto ch = src[pos++];
+    auto digit = range('0', '9');
+    auto word = digit | range('a', 'z') | range('A', 'Z') | single('_');
+    auto space = single(' ') | range('\t', '\r');
+    switch (ch) {
+      case 'd': return digit;
+      case 'D': return ~digit;
+      case 'w': return word;
+      case 'W': return ~word;
+      case 's': return space;
+      case 'S': return ~space;
+      case 't': return single('\t');
+      case 'n': return single('\n');
+      case 'r': return single('\r');
+      case 'f': return single('\f');
+      case 'v': return single('\v');
+      case '0': return single('\0');
+      case 'x': {
+        auto value = 0;
+        for (auto i = 0; i < 2; ++i, ++pos) {
+          if (pos >= src.size()) throw unsupported_pattern{};
+          auto c = src[pos];
+          auto v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+          if (v < 0) throw unsupported_pattern{};
+          value = value * 16 + v;
+        }
+        return single(static_cast<unsigned char>(value));
+      }
+      default:
+        if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')) throw unsupported_pattern{};
+        if (in_class && ch == 'b') throw unsupported_pattern{};
+        return single(static_cast<unsigned char>(ch));
+    }
+  }
+
+  // A single character of a class, or nullopt for a class escape like `\d`.
+  std::optional<unsigned char> class_char(byte_set &set) {
+    if (pos >= src.size()) throw unsupported_pattern{};
+    auto ch = src[pos++];
+    if (ch == '[' && pos < src.size() && (src[pos] == ':' || src[pos] == '=' || src[pos] == '.')) throw unsupported_pattern{};
+    if (ch != '\\') return static_cast<unsigned char>(ch);
+    set = parse_escape(true);
+    if (set.count() == 1) {
+      for (auto i = 0u; i < 256; ++i) {
+        if (set[i]) return static_cast<unsigned char>(i);
+      }
+    }
+    return std::nullopt;
+  }
+
+  byte_set parse_class() {
+    auto negate = at('^');
+    if (negate) ++pos;
+    if (at(']')) throw unsupported_pattern{};
+    auto set = byte_set{};
+    while (!at(']')) {
+      auto escaped = byte_set{};
+      auto first = class_char(escaped);
+      if (!first) {
+        set |= escaped;
+        continue;
+      }
+      if (at('-') && pos + 1 < src.size() && src[pos + 1] != ']') {
+        ++pos;
+        auto last = class_char(escaped);
+        if (!last || *last < *first) throw unsupported_pattern{};
+        set |= range(*first, *last);
+      } else {
+        set.set(*first);
+      }
+    }
+    ++pos;
+    if (icase) set = fold(set);
+    return negate ? ~set : set;
+  }
+};
+
+// Thompson construction: every fragment ends in an epsilon state whose out
+// is filled in by whatever follows. A reversed NFA matches the reversed
+// strings, for finding where a match starts from where it ends.
+struct nfa {
+  static constexpr std::size_t max_states = 1 << 14;
+
+  struct state {
+    int set = -1;
+    int out = -1, out1 = -1;
+  };
+
+  std::vector<state> states{};
+  int start = 0, match = 0;
+  bool reversed = false;
+
+  struct fragment {
+    int start, end;
+  };
+
+  int add(int set = -1, int out = -1, int out1 = -1) {
+    if (states.size() >= max_states) throw unsupported_pattern{};
+    states.push_back({set, out, out1});
+    return static_cast<int>(states.size() - 1);
+  }
+
+  fragment compile(const regex_parser &re, int index) {
+    auto node = re.nodes[static_cast<std::size_t>(index)];
+    switch (node.kind) {
+      case regex_node::empty: {
+        auto s = add();
+        return {s, s};
+      }
+      case regex_node::bytes: {
+        auto e = add();
+        return {add(static_cast<int>(node.set), e), e};
+      }
+      case regex_node::concat: {
+        auto a = compile(re, reversed ? node.right : node.left);
+        auto b = compile(re, reversed ? node.left : node.right);
+        states[static_cast<std::size_t>(a.end)].out = b.start;
+        return {a.start, b.end};
+      }
+      case regex_node::alternate: {
+        auto a = compile(re, node.left);
+        auto b = compile(re, node.right);
+        auto e = add();
+        states[static_cast<std::size_t>(a.end)].out = e;
+        states[static_cast<std::size_t>(b.end)].out = e;
+        return {add(-1, a.start, b.start), e};
+      }
+      default: {
+        auto s = add();
+        auto end = s;
+        for (auto i = 0; i < node.min; ++i) {
+          auto a = compile(re, node.left);
+          states[static_cast<std::size_t>(end)].out = a.start;
+          end = a.end;
+        }
+        if (node.max < 0) {
+          auto a = compile(re, node.left);
+          auto e = add();
+          auto loop = add(-1, a.start, e);
+          states[static_cast<std::size_t>(end)].out = loop;
+          states[static_cast<std::size_t>(a.end)].out = loop;
+          return {s, e};
+        }
+        auto e = add();
+        for (auto i = node.min; i < node.max; ++i) {
+          auto a = compile(re, node.left);
+          auto branch = add(-1, a.start, e);
+          states[static_cast<std::size_t>(end)].out = branch;
+          end = a.end;
+        }
+        states[static_cast<std::size_t>(end)].out = e;
+        return {s, e};
+      }
+    }
+  }
+
+  // Consuming states and the match state reachable through epsilons, in
+  // priority order: `out` is the left alternative or the greedy branch.
+  void closure(int index, std::vector<int> &out, std::vector<bool> &seen) const {
+    while (index >= 0 && !seen[static_cast<std::size_t>(index)]) {
+      seen[static_cast<std::size_t>(index)] = true;
+      auto &st = states[static_cast<std::size_t>(index)];
+      if (st.set >= 0 || index == match) {
+        out.push_back(index);
+        return;
+      }
+      closure(st.out, out, seen);
+      index = st.out1;
+    }
+  }
+};
+
+// Transition table of one DFA: `next[state * class_count + class]` is the
+// next state, or -1 once no thread is left.
+struct dfa_table {
+  std::vector<int> next{};
+  std::vector<char> accept{};
+};
+
+// DFAs over byte equivalence classes, built up front by subset construction.
+// Forward states are NFA state lists in priority order, cut after the match
+// state: once a thread matches, lower priority threads can no longer win,
+// which gives the leftmost-first matches of ECMAScript backtracking.
+//
+// Unanchored searches run in linear time: the forward DFA carries an implicit
+// `.*?` prefix, threads starting at every later position appended at the
+// lowest priority, so one pass finds where the leftmost match ends. A DFA of
+// the reversed pattern then runs back from that end to the leftmost position
+// the match can start at.
+struct automaton {
+  static constexpr std::size_t max_states = 4096;
+
+  std::array<std::uint8_t, 256> classes{};
+  std::size_t class_count = 1;
+  dfa_table forward{}, forward_not_empty{}, backward{};
+  byte_set first{};
+  int only_first = -1;
+  bool anchored_start = false, anchored_end = false;
+
+  automaton(std::string_view source, bool icase) {
+    auto re = regex_parser{source, icase};
+    auto root = re.parse();
+    anchored_start = re.anchored_start;
+    anchored_end = re.anchored_end;
+    split_classes(re.sets);
+    auto graph = nfa{};
+    auto frag = graph.compile(re, root);
+    graph.start = frag.start;
+    graph.match = frag.end;
+    auto seen = std::vector<bool>(graph.states.size());
+    auto start = std::vector<int>{};
+    graph.closure(graph.start, start, seen);
+    auto start_not_empty = start;
+    start_not_empty.erase(std::remove(start_not_empty.begin(), start_not_empty.end(), graph.match), start_not_empty.end());
+    // A pattern anchored at the start is only tried there, so it needs no
+    // prefix and no way back.
+    auto restart = anchored_start ? nullptr : &start;
+    auto restart_not_empty = anchored_start ? nullptr : &start_not_empty;
+    forward = build(re.sets, graph, start, restart, true);
+    forward_not_empty = build(re.sets, graph, start_not_empty, restart_not_empty, true);
+    if (!anchored_start) {
+      auto reversed = nfa{};
+      reversed.reversed = true;
+      auto rfrag = reversed.compile(re, root);
+      reversed.start = rfrag.start;
+      reversed.match = rfrag.end;
+      auto rseen = std::vector<bool>(reversed.states.size());
+      auto rstart = std::vector<int>{};
+      reversed.closure(reversed.start, rstart, rseen);
+      backward = build(re.sets, reversed, rstart, nullptr, false);
+    }
+    auto &table = forward_not_empty;
+    for (auto b = 0u; b < 256; ++b) {
+      if (!table.next.empty() && table.next[classes[b]] > 0) first.set(b);
+    }
+    if (first.count() == 1) {
+      for (auto b = 0u; b < 256; ++b) {
+        if (first[b]) only_first = static_cast<int>(b);
+      }
+    }
+  }
+
+  void split_classes(const std::vector<byte_set> &sets) {
+    for (auto &&set : sets) {
+      auto renumber = std::map<std::pair<int, bool>, std::uint8_t>{};
+      for (auto b = 0u; b < 256; ++b) {
+        auto key = std::pair{static_cast<int>(classes[b]), static_cast<bool>(set[b])};
+        auto it = renumber.try_emplace(key, static_cast<std::uint8_t>(renumber.size())).first;
+        classes[b] = it->second;
+      }
+      class_count = renumber.size();
+    }
+  }
+
+  // State 0 is `start`, an empty list builds an empty table. `restart`, if
+  // any, is the `.*?` prefix: a marker thread of the lowest priority that
+  // starts it again after each byte, until a match cuts it. Unordered tables
+  // are plain subset constructions, for the reversed pattern.
+  dfa_table build(const std::vector<byte_set> &sets, const nfa &graph, std::vector<int> start, const std::vector<int> *restart, bool ordered) const {
+    constexpr auto restart_mark = -2;
+    auto table = dfa_table{};
+    if (start.empty()) return table;
+    if (restart) start.push_back(restart_mark);
+    auto reps = std::vector<unsigned>(class_count);
+    for (auto b = 256u; b-- > 0;) reps[classes[b]] = b;
+    auto index = std::map<std::vector<int>, int>{};
+    auto pending = std::vector<std::vector<int>>{};
+    // With a trailing `$` every forward match ends at the end of the text,
+    // so no thread is cut.
+    auto cut = ordered && !anchored_end;
+    auto intern = [&](std::vector<int> key) {
+      auto matched = std::find(key.begin(), key.end(), graph.match);
+      if (matched != key.end() && cut) key.erase(matched + 1, key.end());
+      if (!ordered) std::sort(key.begin(), key.end());
+      auto [it, inserted] = index.try_emplace(key, static_cast<int>(index.size()));
+      if (inserted) {
+        if (index.size() > max_states) throw unsupported_pattern{};
+        table.accept.push_back(matched != key.end());
+        table.next.resize(table.next.size() + class_count, -1);
+        pending.push_back(std::move(key));
+      }
+      return it->second;
+    };
+    auto seen = std::vector<bool>(graph.states.size());
+    intern(start);
+    for (std::size_t s = 0; s < pending.size(); ++s) {
+      for (std::size_t c = 0; c < class_count; ++c) {
+        auto target = std::vector<int>{};
+        std::fill(seen.begin(), seen.end(), false);
+        for (auto n : pending[s]) {
+          if (n == restart_mark) {
+            for (auto r : *restart) {
+              if (!seen[static_cast<std::size_t>(r)]) target.push_back(r);
+            }
+            target.push_back(restart_mark);
+            continue;
+          }
+          auto &st = graph.states[static_cast<std::size_t>(n)];
+          if (st.set >= 0 && sets[static_cast<std::size_t>(st.set)][reps[c]]) graph.closure(st.out, target, seen);
+        }
+        if (!target.empty()) table.next[s * class_count + c] = intern(std::move(target));
+      }
+    }
+    return table;
+  }
+
+  std::size_t class_of(char ch) const noexcept {
+    return classes[static_cast<unsigned char>(ch)];
+  }
+
+  // Where the match found by a forward pass from `p` ends, or nullptr. The
+  // last accepting state seen holds the highest priority thread that matched.
+  const char *match_end(const dfa_table &table, const char *p, const char *last) const noexcept {
+    if (table.accept.empty()) return nullptr;
+    auto s = 0;
+    auto end = table.accept[0] && (!anchored_end || p == last) ? p : nullptr;
+    while (p != last) {
+      // Bytes that start nothing lead back to the initial state.
+      if (s == 0 && !table.accept[0] && !anchored_start) {
+        if (only_first >= 0) {
+          p = simd::find(p, last, static_cast<char>(only_first));
+        } else {
+          while (p != last && !first[static_cast<unsigned char>(*p)]) ++p;
+        }
+        if (p == last) break;
+      }
+      s = table.next[static_cast<std::size_t>(s) * class_count + class_of(*p)];
+      ++p;
+      if (s < 0) break;
+      if (table.accept[static_cast<std::size_t>(s)] && (!anchored_end || p == last)) end = p;
+    }
+    return end;
+  }
+
+  // The leftmost position at or after `first` from which a match reaches
+  // `end`.
+  const char *match_start(const char *first, const char *end, bool not_empty) const noexcept {
+    auto s = 0;
+    auto start = backward.accept[0] && !not_empty ? end : nullptr;
+    for (auto p = end; p != first;) {
+      --p;
+      s = backward.next[static_cast<std::size_t>(s) * class_count + class_of(*p)];
+      if (s < 0) break;
+      if (backward.accept[static_cast<std::size_t>(s)]) start = p;
+    }
+    return start;
+  }
+
+  // Leftmost-first match at or after `p`.
+  std::optional<std::pair<const char *, const char *>> search(const char *text, const char *p, const char *last, bool not_empty) const noexcept {
+    if (anchored_start && p != text) return std::nullopt;
+    auto end = match_end(not_empty ? forward_not_empty : forward, p, last);
+    if (!end) return std::nullopt;
+    if (anchored_start) return std::pair{p, end};
+    return std::pair{match_start(p, end, not_empty), end};
+  }
+};
+
+} // namespace detail
+
+// A regular expression compiled once for reuse. ECMAScript patterns made of
+// literals, classes, `.`, groups, alternation and greedy quantifiers, with an
+// optional leading `^` and trailing `$`, run on a DFA; other patterns and
+// grammars fall back to `std::regex`. Both find the same leftmost-first
+// matches.
+struct pattern {
+  public:
+  using flag_type = std::regex_constants::syntax_option_type;
+
+  private:
+  std::shared_ptr<const detail::automaton> dfa{};
+  std::shared_ptr<const std::regex> regex{};
+
+  public:
+  pattern() = default;
+
+  explicit pattern(std::string_view source, flag_type flags = std::regex_constants::ECMAScript) {
+    namespace rc = std::regex_constants;
+    auto grammar = flags & ~(rc::icase | rc::nosubs | rc::optimize);
+    if (grammar == rc::ECMAScript || grammar == flag_type{}) {
+      try {
+        dfa = std::make_shared<const detail::automaton>(source, (flags & rc::icase) == rc::icase);
+        return;
+      } catch (const detail::unsupported_pattern &) {
+      }
+    }
+    regex = std::make_shared<const std::regex>(source.begin(), source.end(), flags);
+  }
+
+  // Whether matching runs on the automaton rather than `std::regex`.
+  bool is_automaton() const noexcept {
+    return dfa != nullptr;
+  }
+
+  // Leftmost match in `text` starting at or after `pos`, as a view of it.
+  std::optional<std::string_view> find(std::string_view text, std::size_t pos = 0, bool not_empty = false) const {
+    auto first = text.data(), last = text.data() + text.size();
+    if (dfa) {
+      auto match = dfa->search(first, first + pos, last, not_empty);
+      if (!match) return std::nullopt;
+      return std::string_view(match->first, static_cast<std::size_t>(match->second - match->first));
+    }
+    if (!regex) return std::nullopt;
+    auto flags = std::regex_constants::match_default;
+    if (pos > 0) flags |= std::regex_constants::match_prev_avail;
+    if (not_empty) flags |= std::regex_constants::match_not_null;
+    auto match = std::cmatch{};
+    if (!std::regex_search(first + pos, last, match, *regex, flags)) return std::nullopt;
+    return std::string_view(match[0].first, static_cast<std::size_t>(match[0].length()));
+  }
+};
+
+} // namespace whl::str
+
+#endif // WHEEL_WHL_PATTERN_HPP
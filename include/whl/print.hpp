@@ -21,6 +21,9 @@
 #pragma once
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
 #include <iostream>
 #include <type_traits>
 
@@ -29,9 +32,68 @@
 
 namespace whl {
 
+namespace detail {
+
+// What this thread has printed and not yet written. Whole lines are handed
+// to stdio's `stdout` in one `fwrite`, which locks the stream, as soon as
+// they end, so they keep their order with `std::printf` and `std::cout`
+// (synced with stdio unless told otherwise) and stdio's own buffering
+// decides when they reach the file. A line still being printed stays here
+// until it ends, the buffer fills up, `whl::flush()` or thread exit.
+struct stdout_buffer {
+  static constexpr std::size_t capacity = 1 << 14;
+
+  basic_memory_buffer<char, capacity> buffer;
+
+  stdout_buffer() = default;
+
+  stdout_buffer(const stdout_buffer &) = delete;
+
+  ~stdout_buffer() {
+    flush();
+  }
+
+  void flush() {
+    if (!buffer.empty()) std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+    buffer.clear();
+    std::fflush(stdout);
+  }
+
+  // Called after a print that appended from `from` on.
+  void commit(std::size_t from) {
+    auto first = buffer.data() + from, last = buffer.data() + buffer.size();
+    auto newline = std::find(std::make_reverse_iterator(last), std::make_reverse_iterator(first), '\n').base();
+    if (newline == first) {
+      if (buffer.size() < capacity) return;
+      newline = last;
+    }
+    std::fwrite(buffer.data(), 1, static_cast<std::size_t>(newline - buffer.data()), stdout);
+    auto rest = static_cast<std::size_t>(last - newline);
+    std::copy(newline, last, buffer.data());
+    buffer.resize(rest);
+  }
+};
+
+inline stdout_buffer &local_stdout() {
+  thread_local auto buffer = stdout_buffer{};
+  return buffer;
+}
+
+} // namespace detail
+
+// Printing is buffered per thread and written a line at a time, so lines
+// from concurrent threads do not interleave.
 template<typename T, typename... Args>
 inline void print(const T &arg, const Args &...args) {
-  detail::out_to(std::cout, arg, args...);
+  auto &out = detail::local_stdout();
+  auto from = out.buffer.size();
+  detail::out_to(out.buffer, arg, args...);
+  out.commit(from);
+}
+
+// Writes out what this thread has printed so far and flushes `stdout`.
+inline void flush() {
+  detail::local_stdout().flush();
 }
 
 template<typename... Args>
@@ -47,8 +109,18 @@ inline void println() {
 
 template<typename Fmt, typename... Args>
 inline void printf(const Fmt &fmt, const Args &...args) {
-  detail::format_to(std::cout, std::begin(fmt), std::end(fmt), args...);
+  auto &out = detail::local_stdout();
+  auto from = out.buffer.size();
+  format_to(out.buffer, fmt, args...);
+  out.commit(from);
+}
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+template<fixed_string S, typename... Args>
+inline void printf(const Args &...args) {
+  printf(fmt<fixed_str<S>>{}, args...);
 }
+#endif
 
 } // namespace whl
 
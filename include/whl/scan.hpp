@@ -0,0 +1,208 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_SCAN_HPP
+#define WHEEL_WHL_SCAN_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "whl/format.hpp"
+
+namespace whl {
+
+// Outcome of `scan`: `ec` is empty on success, `position` is the offset in
+// the input where scanning stopped and `count` the number of arguments
+// assigned before that.
+struct scan_result {
+  std::errc ec;
+  std::size_t position;
+  std::size_t count;
+
+  explicit operator bool() const noexcept {
+    return ec == std::errc{};
+  }
+};
+
+namespace detail {
+
+struct scan_state {
+  const char *begin, *first, *last;
+  std::errc ec;
+  std::size_t count;
+
+  bool fail(std::errc error) noexcept {
+    ec = error;
+    return false;
+  }
+};
+
+constexpr bool is_space(char ch) noexcept {
+  return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f' || ch == '\v';
+}
+
+inline void skip_space(scan_state &st) noexcept {
+  while (st.first != st.last && is_space(*st.first)) ++st.first;
+}
+
+// Literal text must match exactly, except that whitespace matches any run
+// of whitespace, including none.
+inline bool scan_literal(scan_state &st, std::string_view text) noexcept {
+  for (auto ch : text) {
+    if (is_space(ch)) {
+      skip_space(st);
+    } else if (st.first != st.last && *st.first == ch) {
+      ++st.first;
+    } else {
+      return st.fail(std::errc::invalid_argument);
+    }
+  }
+  return true;
+}
+
+// Where a string field ends: at the literal that follows it, at whitespace
+// when that literal starts with whitespace or another field follows, or at
+// the end of the input.
+struct field_stop {
+  bool at_space;
+  std::string_view text;
+};
+
+template<typename Fmt, std::size_t I>
+constexpr field_stop stop_of() {
+  if constexpr (I + 1 == Fmt::pieces.size()) {
+    return {false, {}};
+  } else {
+    constexpr auto next = Fmt::pieces[I + 1];
+    constexpr auto text = Fmt::str.substr(next.first, next.size);
+    if (next.placeholder || is_space(text.front())) return {true, {}};
+    return {false, text};
+  }
+}
+
+template<typename T>
+inline bool scan_number(scan_state &st, T &value, char type) noexcept {
+  skip_space(st);
+  auto first = st.first;
+  if (first != st.last && *first == '+') ++first;
+  auto result = std::from_chars_result{};
+  if constexpr (std::is_floating_point_v<T>) {
+    auto format = type == 'e' ? std::chars_format::scientific : type == 'f' ? std::chars_format::fixed : type == 'a' ? std::chars_format::hex : std::chars_format::general;
+    result = std::from_chars(first, st.last, value, format);
+  } else {
+    auto base = type == 'x' ? 16 : type == 'o' ? 8 : type == 'b' ? 2 : 10;
+    result = std::from_chars(first, st.last, value, base);
+  }
+  if (result.ec != std::errc{}) return st.fail(result.ec);
+  st.first = result.ptr;
+  return true;
+}
+
+inline std::string_view scan_field(scan_state &st, field_stop stop) noexcept {
+  auto first = st.first;
+  if (stop.at_space) {
+    while (st.first != st.last && !is_space(*st.first)) ++st.first;
+  } else if (!stop.text.empty()) {
+    auto rest = std::string_view(st.first, static_cast<std::size_t>(st.last - st.first));
+    auto pos = rest.find(stop.text);
+    st.first = pos == std::string_view::npos ? st.last : st.first + pos;
+  } else {
+    st.first = st.last;
+  }
+  return {first, static_cast<std::size_t>(st.first - first)};
+}
+
+template<typename T>
+inline bool scan_value(scan_state &st, T &value, char type, field_stop stop) {
+  if constexpr (std::is_same_v<T, bool>) {
+    auto field = scan_field(st, stop);
+    if (field == "true" || field == "1") {
+      value = true;
+    } else if (field == "false" || field == "0") {
+      value = false;
+    } else {
+      st.first -= field.size();
+      return st.fail(std::errc::invalid_argument);
+    }
+    return true;
+  } else if constexpr (std::is_same_v<T, char>) {
+    if (st.first == st.last) return st.fail(std::errc::invalid_argument);
+    value = *st.first++;
+    return true;
+  } else if constexpr (std::is_arithmetic_v<T>) {
+    return scan_number(st, value, type);
+  } else {
+    static_assert(std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>, "whl::scan: fields are numbers, bool, char or strings");
+    value = T(scan_field(st, stop));
+    return true;
+  }
+}
+
+template<typename Fmt, std::size_t I, typename Tuple>
+inline bool scan_piece(scan_state &st, const Tuple &args) {
+  constexpr auto piece = Fmt::pieces[I];
+  constexpr auto text = Fmt::str.substr(piece.first, piece.size);
+  if constexpr (!piece.placeholder) {
+    return scan_literal(st, text);
+  } else {
+    constexpr auto spec = parse_spec(text.data(), text.data() + text.size());
+    if (!scan_value(st, std::get<piece.index>(args), spec.type, stop_of<Fmt, I>())) return false;
+    ++st.count;
+    return true;
+  }
+}
+
+template<typename Fmt, typename Tuple, std::size_t... I>
+inline void scan_pieces(scan_state &st, const Tuple &args, std::index_sequence<I...>) {
+  (... && scan_piece<Fmt, I>(st, args));
+}
+
+} // namespace detail
+
+// Parses `input` by the compile-time format string `fmt` into `args`, in
+// order; a field's spec may give the base (`x`, `o`, `b`) or float format
+// (`e`, `f`, `a`). String fields may be `std::string_view`s into the input.
+// Errors are reported in the result, arguments past the failure are left
+// untouched.
+template<typename Str, typename... Args>
+inline scan_result scan(fmt<Str>, std::string_view input, Args &...args) {
+  using fmt_type = fmt<Str>;
+  static_assert(fmt_type::args == sizeof...(Args), "whl::scan: argument count does not match the format string");
+  auto st = detail::scan_state{input.data(), input.data(), input.data() + input.size(), std::errc{}, 0};
+  detail::scan_pieces<fmt_type>(st, std::tie(args...), std::make_index_sequence<fmt_type::pieces.size()>());
+  return {st.ec, static_cast<std::size_t>(st.first - st.begin), st.count};
+}
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+template<fixed_string S, typename... Args>
+inline scan_result scan(std::string_view input, Args &...args) {
+  return scan(fmt<fixed_str<S>>{}, input, args...);
+}
+#endif
+
+} // namespace whl
+
+#endif // WHEEL_WHL_SCAN_HPP
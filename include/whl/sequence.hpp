@@ -32,12 +32,12 @@ template<typename Iter>
 struct sequence {
   using const_iterator = Iter;
   using iterator = const_iterator;
-  using value_type = typename Iter::value_type;
-  using pointer = typename Iter::pointer;
-  using reference = typename Iter::reference;
+  using value_type = typename std::iterator_traits<Iter>::value_type;
+  using pointer = typename std::iterator_traits<Iter>::pointer;
+  using reference = typename std::iterator_traits<Iter>::reference;
   using const_reference = const reference;
   using const_pointer = const pointer;
-  using difference_type = typename Iter::difference_type;
+  using difference_type = typename std::iterator_traits<Iter>::difference_type;
 
   private:
   const iterator first, last;
@@ -77,30 +77,30 @@ struct range_iter {
   public:
   constexpr range_iter(Val value) : value(value){};
 
-  value_type operator*() {
+  constexpr value_type operator*() {
     return value;
   }
 
-  pointer operator->() {
+  constexpr pointer operator->() {
     return &value;
   }
 
-  range_iter &operator++() {
+  constexpr range_iter &operator++() {
     ++value;
     return *this;
   }
 
-  range_iter operator++(int) {
+  constexpr range_iter operator++(int) {
     auto it = *this;
     ++*this;
     return it;
   }
 
-  bool operator!=(const range_iter &it) {
+  constexpr bool operator!=(const range_iter &it) {
     return !(*this == it);
   }
 
-  bool operator==(const range_iter &it) {
+  constexpr bool operator==(const range_iter &it) {
     return value == it.value;
   }
 };
@@ -0,0 +1,383 @@
+//
+// Copyright 2021 sea
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef WHEEL_WHL_SIMD_HPP
+#define WHEEL_WHL_SIMD_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WHL_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif // defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define WHL_SIMD_SSSE3 1
+#include <tmmintrin.h>
+#endif // defined(__SSSE3__) || defined(__AVX__)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif // defined(_MSC_VER) && !defined(__clang__)
+
+namespace whl::simd {
+
+// Index of the lowest set bit, `mask` must not be zero.
+inline int ctz(std::uint32_t mask) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+inline int ctz(std::uint64_t mask) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+// Bit i of the result is set iff first[i] == ch, for the 64 bytes at `first`.
+inline std::uint64_t eq_mask64(const char *first, char ch) noexcept {
+#ifdef WHL_SIMD_SSE2
+  auto needle = _mm_set1_epi8(ch);
+  auto mask = std::uint64_t{};
+  for (int i = 0; i < 4; ++i) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + 16 * i));
+    auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+    mask |= std::uint64_t{bits} << (16 * i);
+  }
+  return mask;
+#else
+  auto mask = std::uint64_t{};
+  for (int i = 0; i < 64; ++i) {
+    mask |= std::uint64_t{first[i] == ch} << i;
+  }
+  return mask;
+#endif
+}
+
+// First occurrence of `ch` in [first, last), or `last`.
+inline const char *find(const char *first, const char *last, char ch) noexcept {
+#ifdef WHL_SIMD_SSE2
+  auto needle = _mm_set1_epi8(ch);
+  for (; last - first >= 64; first += 64) {
+    auto a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first)), needle);
+    auto b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first + 16)), needle);
+    auto c = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first + 32)), needle);
+    auto d = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first + 48)), needle);
+    if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))) != 0) {
+      return first + ctz(eq_mask64(first, ch));
+    }
+  }
+  for (; last - first >= 16; first += 16) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+    if (mask != 0) return first + ctz(mask);
+  }
+#endif
+  for (; first != last; ++first) {
+    if (*first == ch) return first;
+  }
+  return last;
+}
+
+// First byte of [first, last) that a JSON string has to escape: a quote, a
+// backslash or a control character; `last` if there is none.
+inline const char *find_json_escape(const char *first, const char *last) noexcept {
+#ifdef WHL_SIMD_SSE2
+  auto quote = _mm_set1_epi8('"');
+  auto backslash = _mm_set1_epi8('\\');
+  auto control = _mm_set1_epi8(0x1f);
+  for (; last - first >= 16; first += 16) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    auto special = _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(block, control), block));
+    auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(special));
+    if (mask != 0) return first + ctz(mask);
+  }
+#endif
+  for (; first != last; ++first) {
+    if (*first == '"' || *first == '\\' || static_cast<unsigned char>(*first) < 0x20) return first;
+  }
+  return last;
+}
+
+// Converts the ASCII letters of [first, last) to upper or lower case in
+// place, 16 bytes at a time. Stops at the first block holding a non-ASCII
+// byte, which may need the locale, and returns where it stopped; `last` when
+// everything was converted.
+inline char *ascii_case(char *first, char *last, bool upper) noexcept {
+  auto from = upper ? 'a' : 'A';
+#ifdef WHL_SIMD_SSE2
+  auto low = _mm_set1_epi8(static_cast<char>(from - 1));
+  auto high = _mm_set1_epi8(static_cast<char>(from + 26));
+  auto bit = _mm_set1_epi8(0x20);
+  for (; last - first >= 16; first += 16) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    if (_mm_movemask_epi8(block) != 0) return first;
+    auto letters = _mm_and_si128(_mm_cmpgt_epi8(block, low), _mm_cmplt_epi8(block, high));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(first), _mm_xor_si128(block, _mm_and_si128(letters, bit)));
+  }
+#endif
+  for (; first != last; ++first) {
+    if (static_cast<unsigned char>(*first) >= 0x80) return first;
+    if (*first >= from && *first < from + 26) *first ^= 0x20;
+  }
+  return last;
+}
+
+// Whether [a, a + size) and [b, b + size) are equal ignoring ASCII case.
+inline bool ascii_iequal(const char *a, const char *b, std::size_t size) noexcept {
+  auto last = a + size;
+#ifdef WHL_SIMD_SSE2
+  auto low = _mm_set1_epi8('A' - 1);
+  auto high = _mm_set1_epi8('Z' + 1);
+  auto bit = _mm_set1_epi8(0x20);
+  auto fold = [&](__m128i block) {
+    auto letters = _mm_and_si128(_mm_cmpgt_epi8(block, low), _mm_cmplt_epi8(block, high));
+    return _mm_or_si128(block, _mm_and_si128(letters, bit));
+  };
+  for (; last - a >= 16; a += 16, b += 16) {
+    auto x = fold(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a)));
+    auto y = fold(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) return false;
+  }
+#endif
+  for (; a != last; ++a, ++b) {
+    auto x = *a >= 'A' && *a <= 'Z' ? *a | 0x20 : *a;
+    auto y = *b >= 'A' && *b <= 'Z' ? *b | 0x20 : *b;
+    if (x != y) return false;
+  }
+  return true;
+}
+
+// Advances `a` and `b`, two sorted arrays of 32 or 64-bit integers, over
+// pairs of 16-byte blocks that have no value in common: all-pairs equality is
+// checked with lane rotations, and the block with the smaller maximum is
+// skipped. Stops at the first block pair sharing a value, or when either
+// array has less than a block left; a no-op without SSE2.
+template<typename T>
+inline void skip_disjoint(const T *&a, const T *a_last, const T *&b, const T *b_last) noexcept {
+  static_assert(std::is_integral_v<T> && (sizeof(T) == 4 || sizeof(T) == 8), "32 or 64-bit integers only");
+#ifdef WHL_SIMD_SSE2
+  constexpr auto width = static_cast<std::ptrdiff_t>(16 / sizeof(T));
+  while (a_last - a >= width && b_last - b >= width) {
+    auto va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+    auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+    auto eq = __m128i{};
+    if constexpr (sizeof(T) == 4) {
+      auto eq0 = _mm_cmpeq_epi32(va, vb);
+      auto eq1 = _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)));
+      auto eq2 = _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2)));
+      auto eq3 = _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)));
+      eq = _mm_or_si128(_mm_or_si128(eq0, eq1), _mm_or_si128(eq2, eq3));
+    } else {
+      // 64-bit lanes are equal iff both of their 32-bit halves are.
+      auto eq0 = _mm_cmpeq_epi32(va, vb);
+      auto eq1 = _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2)));
+      eq0 = _mm_and_si128(eq0, _mm_shuffle_epi32(eq0, _MM_SHUFFLE(2, 3, 0, 1)));
+      eq1 = _mm_and_si128(eq1, _mm_shuffle_epi32(eq1, _MM_SHUFFLE(2, 3, 0, 1)));
+      eq = _mm_or_si128(eq0, eq1);
+    }
+    if (_mm_movemask_epi8(eq) != 0) return;
+    auto a_max = a[width - 1], b_max = b[width - 1];
+    if (a_max <= b_max) a += width;
+    if (b_max <= a_max) b += width;
+  }
+#else
+  (void)a, (void)a_last, (void)b, (void)b_last;
+#endif
+}
+
+enum class compare { equal, not_equal, less, less_equal, greater, greater_equal };
+
+template<compare Op, typename T>
+constexpr bool test(T x, T value) noexcept {
+  if constexpr (Op == compare::equal) return x == value;
+  if constexpr (Op == compare::not_equal) return x != value;
+  if constexpr (Op == compare::less) return x < value;
+  if constexpr (Op == compare::less_equal) return x <= value;
+  if constexpr (Op == compare::greater) return x > value;
+  if constexpr (Op == compare::greater_equal) return x >= value;
+}
+
+namespace detail {
+
+// Element types compared a whole SIMD register at a time.
+template<typename T>
+inline constexpr bool has_block_mask = std::is_same_v<T, float> || std::is_same_v<T, double> || (std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) == 4);
+
+} // namespace detail
+
+#ifdef WHL_SIMD_SSE2
+namespace detail {
+
+// Lane mask of `x <Op> value` for 32-bit integers, with unsigned order
+// obtained by flipping the sign bits first.
+template<compare Op, bool Unsigned>
+inline int mask_epi32(__m128i x, __m128i value) noexcept {
+  if constexpr (Unsigned && Op != compare::equal && Op != compare::not_equal) {
+    auto bias = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    x = _mm_xor_si128(x, bias);
+    value = _mm_xor_si128(value, bias);
+  }
+  auto bits = [](__m128i m) { return _mm_movemask_ps(_mm_castsi128_ps(m)); };
+  if constexpr (Op == compare::equal) return bits(_mm_cmpeq_epi32(x, value));
+  if constexpr (Op == compare::not_equal) return ~bits(_mm_cmpeq_epi32(x, value)) & 0xf;
+  if constexpr (Op == compare::less) return bits(_mm_cmplt_epi32(x, value));
+  if constexpr (Op == compare::less_equal) return ~bits(_mm_cmpgt_epi32(x, value)) & 0xf;
+  if constexpr (Op == compare::greater) return bits(_mm_cmpgt_epi32(x, value));
+  if constexpr (Op == compare::greater_equal) return ~bits(_mm_cmplt_epi32(x, value)) & 0xf;
+}
+
+template<compare Op>
+inline int mask_ps(__m128 x, __m128 value) noexcept {
+  if constexpr (Op == compare::equal) return _mm_movemask_ps(_mm_cmpeq_ps(x, value));
+  if constexpr (Op == compare::not_equal) return _mm_movemask_ps(_mm_cmpneq_ps(x, value));
+  if constexpr (Op == compare::less) return _mm_movemask_ps(_mm_cmplt_ps(x, value));
+  if constexpr (Op == compare::less_equal) return _mm_movemask_ps(_mm_cmple_ps(x, value));
+  if constexpr (Op == compare::greater) return _mm_movemask_ps(_mm_cmpgt_ps(x, value));
+  if constexpr (Op == compare::greater_equal) return _mm_movemask_ps(_mm_cmpge_ps(x, value));
+}
+
+template<compare Op>
+inline int mask_pd(__m128d x, __m128d value) noexcept {
+  if constexpr (Op == compare::equal) return _mm_movemask_pd(_mm_cmpeq_pd(x, value));
+  if constexpr (Op == compare::not_equal) return _mm_movemask_pd(_mm_cmpneq_pd(x, value));
+  if constexpr (Op == compare::less) return _mm_movemask_pd(_mm_cmplt_pd(x, value));
+  if constexpr (Op == compare::less_equal) return _mm_movemask_pd(_mm_cmple_pd(x, value));
+  if constexpr (Op == compare::greater) return _mm_movemask_pd(_mm_cmpgt_pd(x, value));
+  if constexpr (Op == compare::greater_equal) return _mm_movemask_pd(_mm_cmpge_pd(x, value));
+}
+
+// Lane mask of `x <Op> value` for the register at `block`.
+template<compare Op, typename T>
+inline int block_mask(const T *block, T value) noexcept {
+  if constexpr (std::is_same_v<T, float>) {
+    return mask_ps<Op>(_mm_loadu_ps(block), _mm_set1_ps(value));
+  } else if constexpr (std::is_same_v<T, double>) {
+    return mask_pd<Op>(_mm_loadu_pd(block), _mm_set1_pd(value));
+  } else {
+    auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+    return mask_epi32<Op, std::is_unsigned_v<T>>(x, _mm_set1_epi32(static_cast<int>(value)));
+  }
+}
+
+#ifdef WHL_SIMD_SSSE3
+// `pshufb` controls moving the 32-bit lanes set in a 4-bit mask to the
+// front, zeroing the rest.
+struct compress_table {
+  alignas(16) std::uint8_t shuffle[16][16]{};
+  std::uint8_t count[16]{};
+
+  constexpr compress_table() {
+    for (auto mask = 0; mask < 16; ++mask) {
+      auto n = 0;
+      for (auto lane = 0; lane < 4; ++lane) {
+        if (!((mask >> lane) & 1)) continue;
+        for (auto byte = 0; byte < 4; ++byte) {
+          shuffle[mask][n * 4 + byte] = static_cast<std::uint8_t>(lane * 4 + byte);
+        }
+        ++n;
+      }
+      for (auto i = n * 4; i < 16; ++i) {
+        shuffle[mask][i] = 0x80;
+      }
+      count[mask] = static_cast<std::uint8_t>(n);
+    }
+  }
+};
+
+inline constexpr compress_table compress_lanes{};
+#endif // WHL_SIMD_SSSE3
+
+} // namespace detail
+#endif // WHL_SIMD_SSE2
+
+// First element x of [first, last) with `x <Op> value`, or `last`. 32-bit
+// integers, floats and doubles are compared a SIMD register at a time, other
+// types one by one.
+template<compare Op, typename T>
+inline const T *find_compare(const T *first, const T *last, T value) noexcept {
+#ifdef WHL_SIMD_SSE2
+  if constexpr (detail::has_block_mask<T>) {
+    constexpr auto width = static_cast<std::ptrdiff_t>(16 / sizeof(T));
+    for (; last - first >= width; first += width) {
+      auto mask = static_cast<std::uint32_t>(detail::block_mask<Op>(first, value));
+      if (mask != 0) return first + ctz(mask);
+    }
+  }
+#endif
+  for (; first != last; ++first) {
+    if (test<Op>(*first, value)) return first;
+  }
+  return last;
+}
+
+// Copies the elements x of [first, last) with `x <Op> value` to `out`, which
+// must have room for all of them, and returns how many were kept. 32-bit
+// integers, floats and doubles are compared a SIMD register at a time; with
+// SSSE3 the kept lanes are packed by a `pshufb` looked up by the comparison
+// mask and stored at once, otherwise every lane is stored and the output
+// advances by its result. Other types go one by one, also without data
+// dependent branches.
+template<compare Op, typename T>
+inline std::size_t compress(const T *first, const T *last, T value, T *out) noexcept {
+  auto n = std::size_t{};
+#ifdef WHL_SIMD_SSE2
+  if constexpr (detail::has_block_mask<T>) {
+    constexpr auto width = static_cast<std::ptrdiff_t>(16 / sizeof(T));
+    for (; last - first >= width; first += width) {
+      auto mask = detail::block_mask<Op>(first, value);
+#ifdef WHL_SIMD_SSSE3
+      // Doubles move as pairs of 32-bit lanes.
+      auto lanes = sizeof(T) == 8 ? (mask & 1) * 3 | (mask & 2) * 6 : mask;
+      auto control = _mm_load_si128(reinterpret_cast<const __m128i *>(detail::compress_lanes.shuffle[lanes]));
+      auto packed = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first)), control);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + n), packed);
+      n += detail::compress_lanes.count[lanes] * sizeof(std::uint32_t) / sizeof(T);
+#else
+      for (std::ptrdiff_t j = 0; j < width; ++j) {
+        out[n] = first[j];
+        n += static_cast<std::size_t>((mask >> j) & 1);
+      }
+#endif
+    }
+  }
+#endif
+  for (; first != last; ++first) {
+    out[n] = *first;
+    n += static_cast<std::size_t>(test<Op>(*first, value));
+  }
+  return n;
+}
+
+} // namespace whl::simd
+
+#endif // WHEEL_WHL_SIMD_HPP
@@ -22,15 +22,24 @@
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
 #include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <numeric>
+#include <optional>
 #include <regex>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "whl/operation.hpp"
+#include "whl/pattern.hpp"
 #include "whl/sequence.hpp"
+#include "whl/simd.hpp"
 
 namespace whl::str {
 
@@ -72,17 +81,249 @@ struct split_sequence {
   }
 };
 
-template<typename Iter, typename Regex>
-constexpr inline auto split(Iter first, Iter last, const Regex &regex) {
-  return split_sequence{first, last, std::basic_regex(regex)};
+namespace detail {
+
+template<typename Char>
+inline const Char *find_char(const Char *first, const Char *last, Char ch) {
+  if constexpr (std::is_same_v<Char, char>) {
+    return simd::find(first, last, ch);
+  } else {
+    return std::find(first, last, ch);
+  }
+}
+
+// The first occurrence of the delimiter in [first, last) as a range, or an
+// empty range at `last`; `text` is where the whole text begins.
+template<typename Char>
+inline std::pair<const Char *, const Char *> find_delimiter(const Char *, const Char *first, const Char *last, Char delimiter) {
+  auto found = find_char(first, last, delimiter);
+  return {found, found == last ? last : found + 1};
+}
+
+// Candidates for a longer delimiter are found by its first character.
+template<typename Char>
+inline std::pair<const Char *, const Char *> find_delimiter(const Char *, const Char *first, const Char *last, std::basic_string_view<Char> delimiter) {
+  if (delimiter.empty()) return {last, last};
+  auto size = static_cast<std::ptrdiff_t>(delimiter.size());
+  for (; last - first >= size; ++first) {
+    first = find_char(first, last - size + 1, delimiter.front());
+    if (last - first < size) break;
+    if (std::char_traits<Char>::compare(first + 1, delimiter.data() + 1, delimiter.size() - 1) == 0) return {first, first + size};
+  }
+  return {last, last};
 }
 
-template<typename Str, typename Regex>
-constexpr inline auto split(const Str &str, const Regex &regex) {
-  auto sv = std::basic_string_view(str);
+template<typename Char>
+inline std::pair<const Char *, const Char *> find_delimiter(const Char *text, const Char *first, const Char *last, const std::basic_string<Char> &delimiter) {
+  return find_delimiter(text, first, last, std::basic_string_view<Char>(delimiter));
+}
+
+// Empty matches never split.
+inline std::pair<const char *, const char *> find_delimiter(const char *text, const char *first, const char *last, const pattern &delimiter) {
+  auto match = delimiter.find({text, static_cast<std::size_t>(last - text)}, static_cast<std::size_t>(first - text), true);
+  if (!match) return {last, last};
+  return {match->data(), match->data() + match->size()};
+}
+
+} // namespace detail
+
+// Tokens of a text between occurrences of a delimiter, a single character, a
+// string or a pattern, as views of the text. Like the regex split, a delimiter at the
+// very end does not start another token.
+template<typename Char, typename Dlm>
+struct split_iter {
+  public:
+  using value_type = std::basic_string_view<Char>;
+  using pointer = const value_type *;
+  using reference = const value_type &;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  private:
+  const Char *text{}, *next{}, *last{};
+  Dlm delimiter{};
+  value_type token{};
+  bool done{true};
+
+  void advance() {
+    auto [found, after] = detail::find_delimiter(text, next, last, delimiter);
+    token = value_type(next, static_cast<std::size_t>(found - next));
+    next = found == last || after == last ? nullptr : after;
+  }
+
+  public:
+  split_iter() = default;
+
+  split_iter(value_type text, Dlm delimiter)
+      : text(text.data()), next(text.data()), last(text.data() + text.size()), delimiter(std::move(delimiter)), done(false) {
+    advance();
+  }
+
+  reference operator*() const {
+    return token;
+  }
+
+  pointer operator->() const {
+    return &token;
+  }
+
+  split_iter &operator++() {
+    if (next) {
+      advance();
+    } else {
+      done = true;
+    }
+    return *this;
+  }
+
+  split_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator==(const split_iter &it) const {
+    return done == it.done && (done || token.data() == it.token.data());
+  }
+
+  bool operator!=(const split_iter &it) const {
+    return !(*this == it);
+  }
+};
+
+namespace detail {
+
+// Pointers and the iterators of strings and vectors, whose elements can be
+// viewed as an array.
+template<typename Iter>
+inline constexpr bool is_contiguous_iter = std::is_pointer_v<Iter>
+    || std::is_same_v<Iter, typename std::basic_string<typename std::iterator_traits<Iter>::value_type>::iterator>
+    || std::is_same_v<Iter, typename std::basic_string<typename std::iterator_traits<Iter>::value_type>::const_iterator>
+    || std::is_same_v<Iter, typename std::vector<typename std::iterator_traits<Iter>::value_type>::iterator>
+    || std::is_same_v<Iter, typename std::vector<typename std::iterator_traits<Iter>::value_type>::const_iterator>;
+
+// C-strings up to their terminator, strings and views as they are.
+template<typename Str>
+inline auto text_view(const Str &str) {
+  if constexpr (std::is_pointer_v<std::decay_t<Str>>) {
+    return std::basic_string_view(static_cast<std::decay_t<const Str &>>(str));
+  } else {
+    return std::basic_string_view<typename Str::value_type>(str.data(), str.size());
+  }
+}
+
+// String delimiters are copied, so temporaries can be passed.
+template<typename Char, typename Dlm>
+inline auto split_text(std::basic_string_view<Char> text, const Dlm &delimiter) {
+  if constexpr (std::is_same_v<Dlm, Char> || std::is_same_v<Dlm, pattern>) {
+    return sequence{split_iter<Char, Dlm>{text, delimiter}, split_iter<Char, Dlm>{}};
+  } else {
+    using string_type = std::basic_string<Char>;
+    return sequence{split_iter<Char, string_type>{text, string_type(delimiter)}, split_iter<Char, string_type>{}};
+  }
+}
+
+} // namespace detail
+
+// Splits at matches of a regex.
+template<typename Iter, typename Char, typename Traits>
+inline auto split(Iter first, Iter last, const std::basic_regex<Char, Traits> &regex) {
+  return split_sequence{first, last, regex};
+}
+
+template<typename Str, typename Char, typename Traits>
+inline auto split(const Str &str, const std::basic_regex<Char, Traits> &regex) {
+  auto sv = detail::text_view(str);
   return split(std::begin(sv), std::end(sv), regex);
 }
 
+// Splits at a literal character or string, yielding `std::basic_string_view`
+// tokens; the text must outlive them.
+template<typename Str, typename Dlm>
+inline auto split(const Str &str, const Dlm &delimiter) {
+  return detail::split_text(detail::text_view(str), delimiter);
+}
+
+// Other iterators can be split by a regex.
+template<typename Iter, typename Dlm>
+inline auto split(Iter first, Iter last, const Dlm &delimiter) {
+  static_assert(detail::is_contiguous_iter<Iter>, "whl::str::split: literal delimiters need contiguous iterators");
+  using char_type = typename std::iterator_traits<Iter>::value_type;
+  auto size = static_cast<std::size_t>(std::distance(first, last));
+  return detail::split_text(std::basic_string_view<char_type>(size ? &*first : nullptr, size), delimiter);
+}
+
+// Non-empty, non-overlapping matches of `pat` in a text, as views of it.
+struct match_iter {
+  public:
+  using value_type = std::string_view;
+  using pointer = const value_type *;
+  using reference = const value_type &;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  private:
+  std::string_view text{};
+  pattern pat{};
+  std::optional<std::string_view> match{};
+
+  public:
+  match_iter() = default;
+
+  match_iter(std::string_view text, pattern pat) : text(text), pat(std::move(pat)) {
+    match = this->pat.find(text, 0, true);
+  }
+
+  reference operator*() const {
+    return *match;
+  }
+
+  pointer operator->() const {
+    return &*match;
+  }
+
+  match_iter &operator++() {
+    match = pat.find(text, static_cast<std::size_t>(match->data() + match->size() - text.data()), true);
+    return *this;
+  }
+
+  match_iter operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator==(const match_iter &it) const {
+    return match.has_value() == it.match.has_value() && (!match || match->data() == it.match->data());
+  }
+
+  bool operator!=(const match_iter &it) const {
+    return !(*this == it);
+  }
+};
+
+template<typename Str>
+inline auto find_all(const Str &str, const pattern &pat) {
+  return sequence{match_iter{detail::text_view(str), pat}, match_iter{}};
+}
+
+// Copy of the text with every match of `pat` replaced by the literal
+// `replacement`.
+template<typename Str>
+inline std::string replace_all(const Str &str, const pattern &pat, std::string_view replacement) {
+  auto text = std::string_view(detail::text_view(str));
+  auto result = std::string{};
+  result.reserve(text.size());
+  auto pos = std::size_t{};
+  for (auto match = pat.find(text, 0, true); match; match = pat.find(text, pos, true)) {
+    result.append(text.data() + pos, match->data());
+    result.append(replacement);
+    pos = static_cast<std::size_t>(match->data() + match->size() - text.data());
+  }
+  result.append(text.substr(pos));
+  return result;
+}
+
 template<typename CharT = char, typename Iter, typename Dlm>
 constexpr inline auto join(Iter first, Iter last, const Dlm &delimiter) {
   return sequence{first, last} | op::join<CharT>(delimiter);
@@ -93,10 +334,43 @@ constexpr inline auto join(const C &cont, const Dlm &delimiter) {
   return cont | op::join<CharT>(delimiter);
 }
 
+namespace detail {
+
+
+// Plain `char` ranges take the ASCII fast path a block at a time, blocks with
+// non-ASCII bytes and other character types go through the locale.
+template<typename Iter>
+inline void case_inplace(Iter first, Iter last, bool upper) {
+  if constexpr (is_contiguous_iter<Iter> && std::is_same_v<whl::detail::iter_reference_t<Iter>, char &>) {
+    if (first == last) return;
+    auto p = &*first, end = p + (last - first);
+    while ((p = simd::ascii_case(p, end, upper)) != end) {
+      auto stop = p + std::min<std::ptrdiff_t>(16, end - p);
+      for (; p != stop; ++p) {
+        auto ch = static_cast<unsigned char>(*p);
+        *p = static_cast<char>(upper ? std::toupper(ch) : std::tolower(ch));
+      }
+    }
+  } else {
+    std::transform(
+        first, last, first, [upper](auto ch) -> auto{ return upper ? std::toupper(ch) : std::tolower(ch); });
+  }
+}
+
+inline std::uint64_t fold_ascii_word(std::uint64_t word) noexcept {
+  constexpr auto ones = std::uint64_t{0x0101010101010101};
+  auto heptets = word & (0x7f * ones);
+  auto above_z = heptets + (0x7f - 'Z') * ones;
+  auto from_a = heptets + (0x80 - 'A') * ones;
+  auto upper = ~word & (from_a ^ above_z) & (0x80 * ones);
+  return word | (upper >> 2);
+}
+
+} // namespace detail
+
 template<typename Iter>
 inline void toupper_inplace(Iter first, Iter last) {
-  std::transform(
-      first, last, first, [](auto ch) -> auto{ return std::toupper(ch); });
+  detail::case_inplace(first, last, true);
 }
 
 template<typename Str>
@@ -106,8 +380,7 @@ inline void toupper_inplace(Str &str) {
 
 template<typename Iter>
 inline void tolower_inplace(Iter first, Iter last) {
-  std::transform(
-      first, last, first, [](auto ch) -> auto{ return std::tolower(ch); });
+  detail::case_inplace(first, last, false);
 }
 
 template<typename Str>
@@ -115,6 +388,47 @@ inline void tolower_inplace(Str &str) {
   tolower_inplace(std::begin(str), std::end(str));
 }
 
+// Equality ignoring ASCII case; other bytes compare exactly.
+inline bool iequals(std::string_view a, std::string_view b) noexcept {
+  return a.size() == b.size() && simd::ascii_iequal(a.data(), b.data(), a.size());
+}
+
+// Hash consistent with `iequals`, for case-insensitive keys:
+//
+//   std::unordered_map<std::string, int, str::ihash, str::iequal_to>
+struct ihash {
+  using is_transparent = void;
+
+  std::size_t operator()(std::string_view str) const noexcept {
+    auto hash = std::uint64_t{0xcbf29ce484222325};
+    auto mix = [&hash](std::uint64_t word) {
+      hash = (hash ^ word) * 0x100000001b3;
+      hash ^= hash >> 29;
+    };
+    auto p = str.data(), last = str.data() + str.size();
+    for (; last - p >= 8; p += 8) {
+      auto word = std::uint64_t{};
+      std::memcpy(&word, p, 8);
+      mix(detail::fold_ascii_word(word));
+    }
+    if (p != last) {
+      auto word = std::uint64_t{};
+      std::memcpy(&word, p, static_cast<std::size_t>(last - p));
+      mix(detail::fold_ascii_word(word));
+    }
+    mix(str.size());
+    return static_cast<std::size_t>(hash);
+  }
+};
+
+struct iequal_to {
+  using is_transparent = void;
+
+  bool operator()(std::string_view a, std::string_view b) const noexcept {
+    return iequals(a, b);
+  }
+};
+
 template<typename Str>
 constexpr inline auto toupper(const Str &str) {
   auto result = std::basic_string(str);
@@ -21,7 +21,9 @@
 #pragma once
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
+#include <iterator>
 #include <type_traits>
+#include <utility>
 
 namespace whl {
 
@@ -39,6 +41,15 @@ using replace_first_t = typename replace_first<Args...>::type;
 template<typename T>
 using remove_cr_t = std::remove_const_t<std::remove_reference_t<T>>;
 
+template<typename T, typename = void>
+struct is_iterable : std::false_type {};
+
+template<typename T>
+struct is_iterable<T, decltype(std::begin(std::declval<T &>()), void())> : std::true_type {};
+
+template<typename T>
+inline constexpr bool is_iterable_v = is_iterable<T>::value;
+
 } // namespace whl
 
 #endif // WHEEL_WHL_TYPE_HPP
@@ -1,10 +1,21 @@
 #include <algorithm>
 #include <array>
+#include <cctype>
+#include <chrono>
+#include <cmath>
 #include <deque>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <list>
+#include <map>
+#include <numeric>
 #include <optional>
+#include <random>
 #include <set>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -42,12 +53,848 @@ TEST_CASE("string upper & lower") {
   REQUIRE(whl::str::tolower(str.begin() + 1, str.end() - 1) == "owercase_and_uppercas");
 }
 
+TEST_CASE("ascii case folding") {
+  auto text = std::string(40, 'a') + "\xc3\xa9Mixed-Case" + std::string(40, 'Z');
+  auto upper = whl::str::toupper(text);
+  REQUIRE(upper == std::string(40, 'A') + "\xc3\xa9MIXED-CASE" + std::string(40, 'Z'));
+  REQUIRE(whl::str::tolower(upper) == std::string(40, 'a') + "\xc3\xa9mixed-case" + std::string(40, 'z'));
+  auto all = std::string(256, '\0');
+  std::iota(all.begin(), all.end(), '\0');
+  auto expected = all;
+  std::transform(expected.begin(), expected.end(), expected.begin(), [](char ch) { return static_cast<char>(std::toupper(static_cast<unsigned char>(ch))); });
+  whl::str::toupper_inplace(all);
+  REQUIRE(all == expected);
+
+  REQUIRE(whl::str::iequals("Content-Length", "content-LENGTH"));
+  REQUIRE(whl::str::iequals(std::string(33, 'x') + "@[", std::string(33, 'X') + "@["));
+  REQUIRE_FALSE(whl::str::iequals(std::string(33, 'x') + "@", std::string(33, 'X') + "`"));
+  REQUIRE_FALSE(whl::str::iequals("abc", "abcd"));
+  auto hash = whl::str::ihash{};
+  REQUIRE(hash("Accept-Encoding: GZIP") == hash("accept-encoding: gzip"));
+  REQUIRE(hash("") != hash("a"));
+  auto headers = std::unordered_map<std::string, int, whl::str::ihash, whl::str::iequal_to>{{"Host", 1}, {"User-Agent", 2}};
+  REQUIRE(headers.count("HOST") == 1);
+  REQUIRE(headers.at("user-agent") == 2);
+  REQUIRE(headers.count("Hosts") == 0);
+}
+
 TEST_CASE("split string") {
   auto res = whl::str::split("int float double", " ") | whl::op::to<std::vector>();
   REQUIRE(res.size() == 3);
   REQUIRE(res[0] == "int");
   REQUIRE(res[1] == "float");
   REQUIRE(res[2] == "double");
+
+  using tokens = std::vector<std::string_view>;
+  auto split = [](auto &&...args) { return whl::str::split(args...) | whl::op::to<std::vector>(); };
+  REQUIRE(split("a,,b,", ',') == tokens{"a", "", "b"});
+  REQUIRE(split(",a", ',') == tokens{"", "a"});
+  REQUIRE(split("", ',') == tokens{""});
+  REQUIRE(split("k1 => v1 => => v2", std::string_view(" => ")) == tokens{"k1", "v1", "=> v2"});
+  REQUIRE(split("aaa", "aa") == tokens{"", "a"});
+  auto separator = [] { return std::string(", "); };
+  auto joined = std::string("x, y, z");
+  auto count = std::size_t{};
+  for (auto token : whl::str::split(joined, separator())) {
+    count += token.size();
+  }
+  REQUIRE(count == 3);
+  auto line = std::string(100, 'x') + ';' + std::string(50, 'y') + ";;";
+  REQUIRE(split(line, ';') == tokens{std::string_view(line).substr(0, 100), std::string_view(line).substr(101, 50), ""});
+  REQUIRE(split(line.begin(), line.end(), ";;") == tokens{std::string_view(line).substr(0, 151)});
+  auto chars = std::vector<char>{'a', ',', 'b'};
+  REQUIRE(split(chars.cbegin(), chars.cend(), ',') == tokens{"a", "b"});
+  REQUIRE((whl::str::split(std::wstring_view(L"a b"), L' ') | whl::op::count()) == 2);
+
+  auto regex = whl::str::split("a1b22c", std::regex("[0-9]+")) | whl::op::to<std::vector<std::string>>();
+  REQUIRE(regex == std::vector<std::string>{"a", "b", "c"});
+}
+
+TEST_CASE("patterns") {
+  using whl::str::pattern;
+  auto same_as_regex = [](const std::string &text, const char *source) {
+    auto pat = pattern(source);
+    REQUIRE(pat.is_automaton());
+    auto expected = std::vector<std::string>{};
+    auto re = std::regex(source);
+    for (auto it = std::sregex_iterator(text.begin(), text.end(), re); it != std::sregex_iterator(); ++it) {
+      if (it->length() > 0) expected.push_back(it->str());
+    }
+    REQUIRE((whl::str::find_all(text, pat) | whl::op::to<std::vector<std::string>>()) == expected);
+  };
+  auto text = std::string{"id=42, name = Ann;  AGE=7 ,x=  , y=1000"};
+  for (auto source : {"[0-9]+", "\\s*,\\s*", "[a-z]+|=", "(?:[A-Z]{2,3})", "\\d{2}", "n.m", "[^a-z=, ;]+", "^\\w+", "\\d+$", "x=\\s*(?:,)?", "(e|E)=?"}) {
+    same_as_regex(text, source);
+  }
+  auto engine = std::mt19937{3};
+  for (auto round = 0; round < 20; ++round) {
+    auto random = std::string(200, ' ');
+    std::generate(random.begin(), random.end(), [&engine] { return "abc"[engine() % 3]; });
+    for (auto source : {"a+b", "(?:ab|a)(?:bc|b)*", "c[ab]{2,3}c?", "(?:a|b)*c", "b*a|a*b", "(?:aa|ab|ba)+$"}) {
+      same_as_regex(random, source);
+    }
+  }
+  for (auto source : {"a|ab", "(a|ab)(c|bcd)(d*)", "x*|xy", "(?:ab|a)(?:bc|c)?", "b*|abc", "(a|ab)$", "(?:|a)b?", "(?:a|ab){2}"}) {
+    same_as_regex("abcd xy ab abc aab abab a", source);
+  }
+
+  auto csv = pattern("\\s*[,;]\\s*");
+  auto tokens = whl::str::split("a , b;c,,d ;", csv) | whl::op::to<std::vector>();
+  REQUIRE(tokens == std::vector<std::string_view>{"a", "b", "c", "", "d"});
+  REQUIRE(whl::str::replace_all("2024-01-15 and 1999-12-31", pattern("\\d{4}-\\d\\d-\\d\\d"), "<date>") == "<date> and <date>");
+  REQUIRE(whl::str::replace_all("Hello HELLO hello", pattern("hello", std::regex::icase), "bye") == "bye bye bye");
+  REQUIRE(whl::str::replace_all("aaa", pattern("b*"), "-") == "aaa");
+  REQUIRE(pattern("a|ab").find("xabc") == "a");
+  REQUIRE(pattern("(?=a)a|ab").find("xabc") == "a");
+  REQUIRE(pattern("|a").find("a", 0, true) == "a");
+  REQUIRE(!pattern("^b").find("ab"));
+  REQUIRE(!pattern("[0-9]").find("abc"));
+
+  auto many = std::string(1 << 20, 'a');
+  auto started = std::chrono::steady_clock::now();
+  REQUIRE(!pattern("a*b").find(many));
+  REQUIRE(!pattern("(?:a|aa)*c").find(many));
+  REQUIRE(!pattern("a+b$").find(many));
+  REQUIRE(pattern("a*$").find(many, 0, true)->size() == many.size());
+  REQUIRE((whl::str::find_all(many, pattern("a{2}")) | whl::op::count()) == many.size() / 2);
+  REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(2));
+
+  for (auto source : {"(a)\\1", "a+?", "\\bfoo", "(?=a)"}) {
+    REQUIRE(!pattern(source).is_automaton());
+  }
+  REQUIRE(pattern("(\\w+)@\\1").find("me ab@ab") == "ab@ab");
+  REQUIRE_THROWS_AS(pattern("(a"), std::regex_error);
+}
+
+TEST_CASE("io lines") {
+  auto path = std::filesystem::temp_directory_path() / "whl_io_lines.txt";
+  std::ofstream(path) << "first\n\nthird line\nlast";
+  auto lines = whl::io::lines(path);
+  auto res = lines | whl::op::to<std::vector>();
+  REQUIRE(res == std::vector<std::string_view>{"first", "", "third line", "last"});
+
+  auto total = std::size_t{};
+  for (auto &&chunk : whl::io::line_chunks(path, 3)) {
+    total += chunk | whl::op::count();
+  }
+  REQUIRE(total == 4);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("io columns") {
+  auto path = std::filesystem::temp_directory_path() / "whl_io_columns.bin";
+  auto rows = std::vector<std::tuple<int, double, std::int64_t>>{};
+  for (int i = 0; i < 1000; ++i) {
+    rows.emplace_back(i % 7, i * 0.5, 1000000 + i * 3);
+  }
+  using whl::io::encoding;
+  REQUIRE((rows | whl::op::write_columns(path, {encoding::dictionary, encoding::plain, encoding::delta})) == 1000);
+
+  auto file = whl::io::columns<int, double, std::int64_t>(path);
+  REQUIRE(file.size() == 1000);
+  REQUIRE(file.get<0>()[10] == 3);
+  REQUIRE(file.get<1>()[999] == 499.5);
+  REQUIRE(file.get<2>()[500] == 1001500);
+  REQUIRE((file | whl::op::to<std::vector>()) == rows);
+  REQUIRE_THROWS(whl::io::columns<float, double, std::int64_t>(path));
+
+  auto patch = [&path](std::streamoff offset, auto value) {
+    auto io = std::fstream(path, std::ios::in | std::ios::out | std::ios::binary);
+    io.seekp(offset);
+    io.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  };
+  constexpr auto header = std::streamoff{24}, desc = std::streamoff{40};
+  patch(16, std::uint64_t{2000});
+  REQUIRE_THROWS_AS((whl::io::columns<int, double, std::int64_t>(path)), std::runtime_error);
+  patch(16, std::uint64_t{1000});
+  patch(header + 12, std::uint32_t{3});
+  REQUIRE_THROWS_AS((whl::io::columns<int, double, std::int64_t>(path)), std::runtime_error);
+  patch(header + 12, std::uint32_t{1});
+  patch(header + 32, std::uint64_t{1});
+  REQUIRE_THROWS_AS((whl::io::columns<int, double, std::int64_t>(path)), std::runtime_error);
+  patch(header + 32, std::uint64_t{7});
+  patch(header + 2 * desc + 24, std::uint64_t{100});
+  REQUIRE_THROWS_AS((whl::io::columns<int, double, std::int64_t>(path)), std::runtime_error);
+
+  auto nan = std::numeric_limits<double>::quiet_NaN();
+  REQUIRE((std::vector{0.0, -0.0, nan, nan, 1.0} | whl::op::write_columns(path, {encoding::dictionary})) == 5);
+  auto doubles = whl::io::columns<double>(path);
+  REQUIRE(!std::signbit(doubles.get<0>()[0]));
+  REQUIRE(std::signbit(doubles.get<0>()[1]));
+  REQUIRE(std::isnan(doubles.get<0>()[3]));
+  auto dict_size = std::uint64_t{};
+  auto in = std::ifstream(path, std::ios::binary);
+  in.seekg(header + 32);
+  in.read(reinterpret_cast<char *>(&dict_size), sizeof(dict_size));
+  REQUIRE(dict_size == 4);
+  std::filesystem::remove(path);
+  REQUIRE_THROWS_AS((std::vector{1} | whl::op::write_columns(path / "missing")), std::ios_base::failure);
+}
+
+TEST_CASE("io csv") {
+  auto text = std::string{"id,name,score\r\n1,\"Smith, J\",2.5\n\n2,\"say \"\"hi\"\"\",-4\n3,,1e3"};
+  auto rows = whl::io::parse_csv(text) | whl::op::drop(1) | whl::op::map([](auto &&row) {
+                return row.template as<int, std::string, double>();
+              })
+            | whl::op::to<std::vector>();
+  REQUIRE(rows.size() == 3);
+  REQUIRE(rows[0] == std::make_tuple(1, "Smith, J", 2.5));
+  REQUIRE(rows[1] == std::make_tuple(2, "say \"hi\"", -4.0));
+  REQUIRE(rows[2] == std::make_tuple(3, "", 1000.0));
+
+  auto wide = std::string{};
+  for (int i = 0; i < 100; ++i) {
+    wide += std::to_string(i) + "\t\"a\tb\"\n";
+  }
+  auto sum = 0;
+  for (auto &&row : whl::io::parse_csv(wide, '\t')) {
+    REQUIRE(row.size() == 2);
+    REQUIRE(row[1] == "a\tb");
+    sum += row.get<int>(0);
+  }
+  REQUIRE(sum == 4950);
+
+  for (auto &&row : whl::io::parse_csv("true,0,1,false,yes\n")) {
+    REQUIRE(row.as<bool, bool, bool, bool>() == std::make_tuple(true, false, true, false));
+    REQUIRE_THROWS_AS(row.get<bool>(4), std::invalid_argument);
+  }
+
+  auto parse = [](std::string_view text) {
+    auto result = std::vector<std::vector<std::string>>{};
+    for (auto &&row : whl::io::parse_csv(text)) {
+      result.emplace_back(row.begin(), row.end());
+    }
+    return result;
+  };
+  using table = std::vector<std::vector<std::string>>;
+  REQUIRE(parse("a,b,") == table{{"a", "b", ""}});
+  REQUIRE(parse("h1,h2\na,") == table{{"h1", "h2"}, {"a", ""}});
+  REQUIRE(parse("h\n\"\"\n\r\n\"\"") == table{{"h"}, {""}, {""}});
+  REQUIRE(parse("a\n\n").size() == 1);
+}
+
+TEST_CASE("zip") {
+  auto a = std::vector{1, 2, 3, 4};
+  auto b = std::vector{10.0, 20.0, 30.0};
+  auto zipped = a | whl::op::zip(b, std::vector<char>{'x', 'y', 'z', 'w'});
+  REQUIRE(std::distance(zipped.begin(), zipped.end()) == 3);
+  for (auto [x, y, z] : zipped) {
+    y += x;
+  }
+  REQUIRE(b == std::vector{11.0, 22.0, 33.0});
+  REQUIRE(zipped.begin()[2] == std::make_tuple(3, 33.0, 'z'));
+
+  auto pairs = whl::range(0, 10) | whl::op::zip(a) | whl::op::to<std::vector>();
+  REQUIRE(pairs.size() == 4);
+  REQUIRE(pairs[3] == std::make_pair(3, 4));
+  auto sums = a | whl::op::zip(b, whl::func::plus) | whl::op::to<std::vector>();
+  REQUIRE(sums == std::vector{12.0, 24.0, 36.0});
+}
+
+TEST_CASE("concat") {
+  auto a = std::vector{3, 1};
+  auto b = std::vector<int>{};
+  auto c = std::list{5, 2};
+  auto all = a | whl::op::concat(b, c, std::vector{4});
+  a[0] = 6;
+  REQUIRE((all | whl::op::to<std::vector>()) == std::vector{6, 1, 5, 2, 4});
+  REQUIRE((all | whl::op::to<std::set<int>>()) == std::set{1, 2, 4, 5, 6});
+  REQUIRE((all | whl::op::count()) == 5);
+  REQUIRE((all | whl::op::sum<int>()) == 18);
+  REQUIRE((all | whl::op::reduce(whl::func::minus)) == -6);
+  REQUIRE((all | whl::op::min()) == 1);
+  REQUIRE((all | whl::op::max()) == 6);
+  REQUIRE((all | whl::op::any(whl::func::equal_with(4))));
+  REQUIRE((all | whl::op::map(whl::func::identity) | whl::op::count(whl::func::great_than(2))) == 3);
+}
+
+TEST_CASE("chunk & par_chunks") {
+  auto vec = std::vector<int>(1000);
+  std::iota(vec.begin(), vec.end(), 0);
+  auto chunks = vec | whl::op::chunk(300);
+  REQUIRE(chunks.end() - chunks.begin() == 4);
+  REQUIRE(chunks.begin()[3].size() == 100);
+  REQUIRE(chunks.begin()[1].front() == 300);
+
+  auto sums = vec | whl::op::par_chunks(64, [](auto &&span) { return span | whl::op::sum<long>(); });
+  REQUIRE(sums.size() == 16);
+  REQUIRE(sums[1] == (64 + 127) * 32);
+  REQUIRE((sums | whl::op::sum<long>()) == 999 * 500);
+
+  auto counts = std::deque<int>(vec.begin(), vec.end())
+              | whl::op::par_chunks_unordered(100, [](auto &&seq) { return seq | whl::op::count(); });
+  REQUIRE((counts | whl::op::sum<long>()) == 1000);
+}
+
+namespace {
+
+struct copy_counter {
+  static inline int copies = 0;
+  int value;
+
+  copy_counter(int value) : value(value) {}
+  copy_counter(const copy_counter &c) : value(c.value) { ++copies; }
+  copy_counter(copy_counter &&) = default;
+  copy_counter &operator=(const copy_counter &c) {
+    value = c.value;
+    ++copies;
+    return *this;
+  }
+  copy_counter &operator=(copy_counter &&) = default;
+  bool operator<(const copy_counter &c) const { return value < c.value; }
+  bool operator==(const copy_counter &c) const { return value == c.value; }
+};
+
+} // namespace
+
+TEST_CASE("move through pipeline") {
+  auto vec = std::vector<copy_counter>{};
+  for (int i : {5, 3, 3, 1, 5, 2}) {
+    vec.emplace_back(i);
+  }
+  copy_counter::copies = 0;
+  auto &same = vec | whl::op::foreach (whl::func::empty_consumer);
+  REQUIRE(&same == &vec);
+  auto sorted = std::move(vec)
+              | whl::op::foreach (whl::func::empty_consumer)
+              | whl::op::sort()
+              | whl::op::distinct()
+              | whl::op::shuffle()
+              | whl::op::sort();
+  REQUIRE(copy_counter::copies == 0);
+  REQUIRE(sorted.size() == 4);
+
+  auto lvalue = std::vector{3, 1, 2};
+  REQUIRE((lvalue | whl::op::sort()) == std::vector{1, 2, 3});
+  REQUIRE(lvalue == std::vector{3, 1, 2});
+}
+
+TEST_CASE("cache") {
+  auto calls = 0;
+  auto expensive = [&calls](int x) {
+    ++calls;
+    return x * 2;
+  };
+  auto vec = std::vector{1, 2, 3, 4};
+  REQUIRE((vec | whl::op::map(expensive) | whl::op::average<double>()) == 5.0);
+  REQUIRE(calls == 4);
+
+  calls = 0;
+  auto cached = vec | whl::op::map(expensive) | whl::op::filter(whl::func::great_than(2)) | whl::op::cache();
+  REQUIRE((cached | whl::op::count()) == 3);
+  REQUIRE((cached | whl::op::sum<int>()) == 18);
+  REQUIRE((cached | whl::op::to<std::vector>()) == std::vector{4, 6, 8});
+  REQUIRE(calls == 4);
+}
+
+TEST_CASE("aggregate & tee") {
+  auto calls = 0;
+  auto values = whl::range(1, 11) | whl::op::map([&calls](int x) {
+                  ++calls;
+                  return x * x;
+                });
+  auto [sum, min, max, count, avg] = values
+                                   | whl::op::aggregate(whl::op::sum<int>(), whl::op::min(), whl::op::max(),
+                                                        whl::op::count(), whl::op::average<double>());
+  REQUIRE(calls == 10);
+  REQUIRE(sum == 385);
+  REQUIRE(min == 1);
+  REQUIRE(max == 100);
+  REQUIRE(count == 10);
+  REQUIRE(avg == 38.5);
+
+  calls = 0;
+  auto [fours, firsts] = values
+                       | whl::op::tee(whl::op::count(whl::func::equal_with(4)),
+                                      [](auto &&seq) { return seq | whl::op::take(3) | whl::op::to<std::vector>(); });
+  REQUIRE(calls == 10);
+  REQUIRE(fours == 1);
+  REQUIRE(firsts == std::vector{1, 4, 9});
+}
+
+TEST_CASE("summation") {
+  auto cancel = std::vector{1.0, 1e100, 1.0, -1e100};
+  REQUIRE((cancel | whl::op::sum<double>()) == 0.0);
+  REQUIRE((cancel | whl::op::sum<double>(whl::op::kahan)) == 2.0);
+  REQUIRE((cancel | whl::op::reverse() | whl::op::sum<double>(whl::op::kahan)) == 2.0);
+
+  auto tenths = std::vector<float>(1000000, 0.1f);
+  REQUIRE(std::abs((tenths | whl::op::sum<float>()) - 100000.0f) > 100.0f);
+  REQUIRE(std::abs((tenths | whl::op::sum<float>(whl::op::pairwise)) - 100000.0f) < 1.0f);
+  REQUIRE(std::abs((tenths | whl::op::sum<float>(whl::op::kahan)) - 100000.0f) < 1.0f);
+  REQUIRE(std::abs((tenths | whl::op::average<float>(whl::op::pairwise)) - 0.1f) < 1e-6f);
+
+  auto engine = std::mt19937{42};
+  auto dist = std::uniform_real_distribution<double>{-1e6, 1e6};
+  auto values = std::vector<double>(100003);
+  std::generate(values.begin(), values.end(), [&] { return dist(engine); });
+  auto pairwise = values | whl::op::sum<double>(whl::op::pairwise);
+  auto single = whl::thread_pool{1};
+  auto triple = whl::thread_pool{3};
+  REQUIRE((values | whl::op::sum<double>(whl::op::parallel)) == pairwise);
+  REQUIRE((values | whl::op::sum<double>(whl::op::parallel, single)) == pairwise);
+  REQUIRE((values | whl::op::sum<double>(whl::op::parallel, triple)) == pairwise);
+  REQUIRE((values | whl::op::map([](double x) { return x; }) | whl::op::sum<double>(whl::op::pairwise)) == pairwise);
+
+  auto [kahan, count] = cancel | whl::op::aggregate(whl::op::sum<double>(whl::op::kahan), whl::op::count());
+  REQUIRE(kahan == 2.0);
+  REQUIRE(count == 4);
+}
+
+TEST_CASE("merge") {
+  auto a = std::vector{1, 4, 7, 10};
+  auto b = std::vector{2, 5, 8};
+  auto c = std::vector{0, 3, 6, 9, 11};
+  REQUIRE((a | whl::op::merge(b, c) | whl::op::to<std::vector>()) == std::vector{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+  REQUIRE((a | whl::op::merge(std::vector<int>{}) | whl::op::to<std::vector>()) == a);
+  REQUIRE((std::vector<int>{} | whl::op::merge(std::vector<int>{}) | whl::op::count()) == 0);
+
+  auto desc = std::vector{9, 5, 1};
+  REQUIRE((desc | whl::op::merge(std::vector{8, 2}, std::greater<>{}) | whl::op::to<std::vector>())
+          == std::vector{9, 8, 5, 2, 1});
+
+  using entry = std::pair<int, char>;
+  auto by_key = [](const entry &l, const entry &r) { return l.first < r.first; };
+  auto left = std::vector<entry>{{1, 'a'}, {2, 'a'}};
+  auto right = std::vector<entry>{{1, 'b'}, {2, 'b'}};
+  REQUIRE((left | whl::op::merge(right, by_key) | whl::op::to<std::vector>())
+          == std::vector<entry>{{1, 'a'}, {1, 'b'}, {2, 'a'}, {2, 'b'}});
+
+  const auto &const_b = b;
+  REQUIRE((a | whl::op::merge(const_b) | whl::op::to<std::vector>()) == std::vector{1, 2, 4, 5, 7, 8, 10});
+  auto deque = std::deque{3, 6};
+  auto list = std::list{0, 12};
+  REQUIRE((a | whl::op::merge(deque, list, std::vector{5}) | whl::op::to<std::vector>())
+          == std::vector{0, 1, 3, 4, 5, 6, 7, 10, 12});
+  REQUIRE((std::vector<long>{1, 5} | whl::op::merge(std::deque<int>{2, 3}) | whl::op::to<std::vector>()) == std::vector<long>{1, 2, 3, 5});
+
+  auto shards = std::vector<std::vector<int>>{};
+  for (int i = 0; i < 100; ++i) {
+    shards.push_back(whl::range(0, 10) | whl::op::map([i](int j) { return i + j * 100; }) | whl::op::to<std::vector>());
+  }
+  auto merged = shards | whl::op::merge_all() | whl::op::to<std::vector>();
+  REQUIRE(merged.size() == 1000);
+  REQUIRE(std::is_sorted(merged.begin(), merged.end()));
+  REQUIRE(merged.front() == 0);
+  REQUIRE(merged.back() == 999);
+
+  auto generated = whl::range(0, 3) | whl::op::map([](int i) { return std::vector{i, i + 3, i + 6}; });
+  REQUIRE((generated | whl::op::merge_all() | whl::op::to<std::vector>()) == std::vector{0, 1, 2, 3, 4, 5, 6, 7, 8});
+}
+
+TEST_CASE("set operations") {
+  auto expect = [](auto &&a, auto &&b) {
+    using value_type = typename std::decay_t<decltype(a)>::value_type;
+    auto intersection = std::vector<value_type>{}, united = intersection, difference = intersection;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(intersection));
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(united));
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(difference));
+    REQUIRE((a | whl::op::set_intersection(b) | whl::op::to<std::vector>()) == intersection);
+    REQUIRE((a | whl::op::set_union(b) | whl::op::to<std::vector>()) == united);
+    REQUIRE((a | whl::op::set_difference(b) | whl::op::to<std::vector>()) == difference);
+  };
+  auto engine = std::mt19937{7};
+  auto sorted = [&engine](auto value, std::size_t n, int range) {
+    auto dist = std::uniform_int_distribution<int>{0, range};
+    auto result = std::vector<decltype(value)>(n);
+    std::generate(result.begin(), result.end(), [&] { return static_cast<decltype(value)>(dist(engine)); });
+    std::sort(result.begin(), result.end());
+    return result;
+  };
+  expect(sorted(0, 1000, 3000), sorted(0, 1500, 3000));
+  expect(sorted(0, 1000, 100), sorted(0, 1000, 100));
+  expect(sorted(std::int64_t{}, 1000, 3000), sorted(std::int64_t{}, 800, 3000));
+  expect(sorted(0u, 10, 100000), sorted(0u, 50000, 100000));
+  expect(sorted(0, 50000, 100000), sorted(0, 7, 100000));
+  expect(std::vector<int>{}, sorted(0, 10, 100));
+  expect(std::list{1, 2, 2, 5, 9}, std::list{2, 2, 2, 3, 9});
+  auto ints = sorted(0, 1000, 3000), others = sorted(0, 1000, 3000);
+  expect(ints, std::deque<int>(others.begin(), others.end()));
+  expect(ints, std::list<int>(others.begin(), others.end()));
+  expect(std::deque<int>(ints.begin(), ints.end()), others);
+
+  auto desc = std::vector{9, 7, 5, 3};
+  REQUIRE((desc | whl::op::set_intersection(std::vector{8, 7, 3}, std::greater<>{}) | whl::op::to<std::vector>())
+          == std::vector{7, 3});
+
+  auto lists = std::vector<std::vector<int>>{{1, 3, 5, 7, 9, 11, 13}, {3, 4, 5, 9, 13, 20}, {0, 3, 9, 13}};
+  REQUIRE((lists | whl::op::set_intersection_all() | whl::op::to<std::vector>()) == std::vector{3, 9, 13});
+  lists.push_back({});
+  REQUIRE((lists | whl::op::set_intersection_all() | whl::op::count()) == 0);
+}
+
+TEST_CASE("filter compaction") {
+  auto check = [](auto values, auto pred) {
+    auto expected = std::vector<typename decltype(values)::value_type>{};
+    std::copy_if(values.begin(), values.end(), std::back_inserter(expected), pred);
+    auto result = values | whl::op::compact(pred);
+    REQUIRE(std::is_same_v<decltype(result), decltype(expected)>);
+    REQUIRE(result == expected);
+    REQUIRE((values | whl::op::filter(pred) | whl::op::to<std::vector>()) == expected);
+  };
+  auto ints = whl::range(-50, 51) | whl::op::to<std::vector>();
+  check(ints, whl::func::great_than(7));
+  check(ints, whl::func::less_than(-7));
+  check(ints, whl::func::great_equal_than(0));
+  check(ints, whl::func::less_equal_than(3));
+  check(ints, whl::func::equal_with(42));
+  check(ints, whl::func::not_equal_with(0));
+  check(ints, whl::func::great_than(2.5));
+
+  auto unsigneds = std::vector<unsigned>{0, 1, 0x7fffffffu, 0x80000000u, 0xffffffffu, 5, 6, 7, 8};
+  check(unsigneds, whl::func::great_than(6u));
+  check(unsigneds, whl::func::less_than(0x80000001u));
+
+  auto floats = std::vector<float>{0.5f, -1.0f, 2.0f, 3.5f, 7.0f, -0.0f, 1.5f};
+  check(floats, whl::func::great_than(1));
+  check(floats, whl::func::not_equal_with(2.0f));
+  check(floats, whl::func::less_equal_than(0.1));
+
+  auto nans = std::vector<float>{std::nanf(""), 2.0f, std::nanf(""), 0.0f, 3.0f};
+  REQUIRE((nans | whl::op::compact(whl::func::great_than(1.0f))) == std::vector{2.0f, 3.0f});
+  REQUIRE((nans | whl::op::filter(whl::func::not_equal_with(2.0f)) | whl::op::count()) == 4);
+
+  auto doubles = std::vector{1.0, 2.0, 3.0, 4.0, 5.0};
+  check(doubles, whl::func::great_equal_than(3.0));
+  check(std::vector<std::int64_t>{1, -2, 3, -4, 5}, whl::func::less_than(0));
+  check(std::vector<short>{1, 2, 3}, whl::func::equal_with(2));
+
+  auto list = std::list{1, 5, 10};
+  REQUIRE((list | whl::op::compact(whl::func::great_than(4))) == std::vector{5, 10});
+  auto large = whl::range(0, 1000) | whl::op::to<std::vector>();
+  REQUIRE((large | whl::op::compact(whl::func::great_equal_than(900))) == (whl::range(900, 1000) | whl::op::to<std::vector>()));
+
+  auto engine = std::mt19937{7};
+  auto sparse = std::vector<int>(1000);
+  std::generate(sparse.begin(), sparse.end(), [&engine] { return static_cast<int>(engine() % 100); });
+  check(sparse, whl::func::great_than(97));
+  check(sparse | whl::op::map([](int x) { return static_cast<unsigned>(x); }) | whl::op::to<std::vector>(), whl::func::equal_with(3u));
+  check(sparse | whl::op::map([](int x) { return x * 0.5f; }) | whl::op::to<std::vector>(), whl::func::less_than(0.5f));
+  check(sparse | whl::op::map([](int x) { return x * 0.25; }) | whl::op::to<std::vector>(), whl::func::great_equal_than(24.5));
+  const auto &view = sparse;
+  auto it = (view | whl::op::filter(whl::func::equal_with(99))).begin();
+  REQUIRE(*it == 99);
+  REQUIRE(*++it == 99);
+}
+
+TEST_CASE("histogram") {
+  auto values = std::vector{-5.0, 0.0, 0.5, 1.0, 2.5, 9.99, 10.0, 42.0};
+  REQUIRE((values | whl::op::histogram(0.0, 10.0, 5)) == std::vector<std::size_t>{4, 1, 0, 0, 3});
+  REQUIRE((values | whl::op::histogram(std::vector{0.0, 1.0, 5.0, 10.0})) == std::vector<std::size_t>{3, 2, 3});
+  REQUIRE((std::list{1, 2, 3, 3, 3} | whl::op::histogram(0, 4, 4)) == std::vector<std::size_t>{0, 1, 1, 3});
+
+  auto engine = std::mt19937{1};
+  auto dist = std::uniform_int_distribution<int>{0, 999};
+  auto samples = std::vector<int>(1 << 20);
+  std::generate(samples.begin(), samples.end(), [&] { return dist(engine); });
+  auto expected = std::vector<std::size_t>(100);
+  for (auto x : samples) {
+    ++expected[x / 10];
+  }
+  auto triple = whl::thread_pool{3};
+  REQUIRE((samples | whl::op::histogram(0, 1000, 100)) == expected);
+  REQUIRE((samples | whl::op::histogram(0, 1000, 100, triple)) == expected);
+  REQUIRE((samples | whl::op::map([](int x) { return x; }) | whl::op::histogram(0, 1000, 100)) == expected);
+  auto edges = whl::range(0, 101) | whl::op::map([](int i) { return i * 10; }) | whl::op::to<std::vector>();
+  REQUIRE((samples | whl::op::histogram(edges, triple)) == expected);
+}
+
+namespace {
+
+constexpr auto square = [](int x) { return x * x; };
+constexpr auto odd = [](int x) { return x % 2 != 0; };
+
+} // namespace
+
+TEST_CASE("constexpr pipelines") {
+  constexpr auto values = std::array{3, 1, 4, 1, 5, 9, 2, 6};
+  static_assert((values | whl::op::map(square) | whl::op::sum<int>()) == 173);
+  static_assert((values | whl::op::filter(odd) | whl::op::count()) == 5);
+  static_assert((values | whl::op::filter(whl::func::great_than(2)) | whl::op::count()) == 5);
+  static_assert((values | whl::op::filter(odd) | whl::op::map(square) | whl::op::reduce(whl::func::plus)) == 117);
+  static_assert((values | whl::op::count(odd)) == 5);
+  static_assert((values | whl::op::min()) == 1);
+  static_assert((values | whl::op::max()) == 9);
+  static_assert((values | whl::op::take(3) | whl::op::fold(0, whl::func::plus)) == 8);
+  static_assert((values | whl::op::drop(6) | whl::op::all(whl::func::less_than(7))));
+  static_assert((values | whl::op::any(whl::func::equal_with(9))));
+  static_assert((values | whl::op::none(whl::func::great_than(9))));
+  static_assert((values | whl::op::average<double>()) == 3.875);
+
+  constexpr auto table = whl::range(0, 8) | whl::op::map(square) | whl::op::to<std::array<int, 8>>();
+  static_assert(table[7] == 49);
+  REQUIRE(table == std::array{0, 1, 4, 9, 16, 25, 36, 49});
+  REQUIRE((std::vector{1, 2, 3} | whl::op::to<std::array<int, 3>>()) == std::array{1, 2, 3});
+  REQUIRE((std::deque{4, 5} | whl::op::to<std::array<int, 2>>()) == std::array{4, 5});
+}
+
+TEST_CASE("compile-time format") {
+  REQUIRE(whl::format(WHL_FMT("{} + {} = {}"), 1, 2, 3) == "1 + 2 = 3");
+  REQUIRE(whl::format(WHL_FMT("[{}] {{{}}}"), "a", std::vector{1, 2}) == "[a] {[1, 2]}");
+  REQUIRE(whl::format(WHL_FMT("no args")) == "no args");
+  REQUIRE(whl::format(WHL_FMT("{}{}"), std::pair{1, 'x'}, true) == "(1, x)true");
+
+  auto fmt = WHL_FMT("a{}b{:x}c");
+  using fmt_type = decltype(fmt);
+  static_assert(fmt_type::args == 2);
+  static_assert(fmt_type::pieces.size() == 5);
+  static_assert(fmt_type::str.substr(fmt_type::pieces[3].first, fmt_type::pieces[3].size) == ":x");
+  REQUIRE(whl::format(std::string{"{} and {}"}, 1, 2) == whl::format(WHL_FMT("{} and {}"), 1, 2));
+}
+
+namespace {
+
+struct point {
+  int x, y;
+};
+
+} // namespace
+
+template<>
+struct whl::formatter<point> {
+
+  template<typename OutIt, typename FmtIter>
+  OutIt operator()(const point &p, OutIt out, FmtIter first, FmtIter last) {
+    return whl::format_to(out, "<{}, {}>", p.x, p.y);
+  }
+};
+
+TEST_CASE("format to buffers") {
+  auto buffer = whl::memory_buffer{};
+  whl::format_to(buffer, "{} and {}", 1, 2);
+  REQUIRE(buffer.view() == "1 and 2");
+  REQUIRE(buffer.capacity() == 500);
+  whl::format_to(buffer, WHL_FMT(" {}"), std::string(600, 'x'));
+  REQUIRE(buffer.size() == 608);
+  REQUIRE(buffer.capacity() >= 608);
+
+  REQUIRE(whl::format("{} and {}", 1, 2) == "1 and 2");
+  REQUIRE(whl::format("{{{}}} }}", point{1, 2}) == "{<1, 2>} }");
+  REQUIRE(whl::format("{} {}", 1) == "1 {}");
+  REQUIRE(whl::format(L"{}-{}", 1, L"a") == L"1-a");
+  REQUIRE(whl::formatted_size("{}, {}", 100, "abc") == 8);
+  REQUIRE(whl::formatted_size(WHL_FMT("{}"), std::vector{1, 2, 3}) == 9);
+
+  char out[8]{};
+  auto result = whl::format_to_n(out, 5, "{}", "truncated");
+  REQUIRE(result.size == 9);
+  REQUIRE(result.out == out + 5);
+  REQUIRE(std::string_view(out) == "trunc");
+
+  auto str = std::string{};
+  whl::format_to(std::back_inserter(str), "{}/{}", point{3, 4}, std::pair{'a', true});
+  REQUIRE(str == "<3, 4>/(a, true)");
+  REQUIRE(whl::to_string(1, ' ', 2.5) == "1 2.5");
+}
+
+TEST_CASE("numeric format specs") {
+  REQUIRE(whl::format("{} {} {}", 0, -1234567890, std::numeric_limits<std::int64_t>::min()) == "0 -1234567890 -9223372036854775808");
+  REQUIRE(whl::format("{}", std::numeric_limits<std::uint64_t>::max()) == "18446744073709551615");
+  REQUIRE(whl::format("{}", std::uint8_t{65}) == "65");
+  REQUIRE(whl::format("{:x} {:#X} {:#o} {:b} {:#b}", 255, 255, 8, 5, 0) == "ff 0XFF 010 101 0b0");
+  REQUIRE(whl::format("[{:5}] [{:<5}] [{:^5}] [{:*>5}]", 42, 42, 42, 42) == "[   42] [42   ] [ 42  ] [***42]");
+  REQUIRE(whl::format("{:+} {: } {:+05} {:#06x}", 7, 7, -7, 255) == "+7  7 -0007 0x00ff");
+
+  REQUIRE(whl::format("{} {} {}", 0.1, 2.5f, 1e100) == "0.1 2.5 1e+100");
+  REQUIRE(whl::format("{}", 3.141592653589793) == "3.141592653589793");
+  REQUIRE(whl::format("{:.2f} {:e} {:.3G} {:.1}", 3.14159, 1234.5, 0.000012345, 0.25) == "3.14 1.234500e+03 1.23E-05 0.2");
+  REQUIRE(whl::format("{:08.3f} {:+} {:>6}", -2.5, 1.5, 0.5) == "-002.500 +1.5    0.5");
+  REQUIRE(whl::format("{:05}", std::numeric_limits<double>::infinity()) == "  inf");
+  REQUIRE(whl::format("{:.300f}", 1.0).size() == 302);
+  REQUIRE(whl::format(WHL_FMT("{:>4}|{:<4}"), 1, 2) == "   1|2   ");
+  REQUIRE(whl::format(L"{:x}", 255) == L"ff");
+  REQUIRE(whl::format("{}", std::vector{std::pair{1, 0.5}}) == "[(1, 0.5)]");
+}
+
+#ifdef WHL_IO_POSIX
+TEST_CASE("buffered print") {
+  auto path = std::filesystem::temp_directory_path() / "whl_print.txt";
+  whl::flush();
+  std::cout.flush();
+  auto saved = ::dup(STDOUT_FILENO);
+  auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ::dup2(fd, STDOUT_FILENO);
+
+  auto threads = std::vector<std::thread>{};
+  for (auto t = 0; t < 4; ++t) {
+    threads.emplace_back([t] {
+      for (auto i = 0; i < 2000; ++i) {
+        whl::print(t, ':');
+        whl::printf("{} {}\n", i, std::string(static_cast<std::size_t>(i % 50), 'x'));
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  whl::print("unterminated");
+  whl::flush();
+  ::dup2(saved, STDOUT_FILENO);
+  ::close(saved);
+  ::close(fd);
+
+  auto lines = whl::io::lines(path) | whl::op::to<std::vector<std::string>>();
+  REQUIRE(lines.size() == 8001);
+  REQUIRE(lines.back() == "unterminated");
+  auto counts = std::array<int, 4>{};
+  auto intact = true;
+  for (auto it = lines.begin(); it != lines.end() - 1; ++it) {
+    auto t = (*it)[0] - '0', i = std::stoi(it->substr(2));
+    intact = intact && *it == whl::format("{}:{} {}", t, i, std::string(static_cast<std::size_t>(i % 50), 'x'));
+    intact = intact && counts[static_cast<std::size_t>(t)]++ == i;
+  }
+  REQUIRE(intact);
+
+  whl::flush();
+  std::cout.flush();
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  saved = ::dup(STDOUT_FILENO);
+  ::dup2(fd, STDOUT_FILENO);
+  whl::println("first");
+  std::cout << "second" << std::endl;
+  std::puts("third");
+  whl::println("fourth");
+  whl::flush();
+  ::dup2(saved, STDOUT_FILENO);
+  ::close(saved);
+  ::close(fd);
+  lines = whl::io::lines(path) | whl::op::to<std::vector<std::string>>();
+  REQUIRE(lines == std::vector<std::string>{"first", "second", "third", "fourth"});
+  std::filesystem::remove(path);
+}
+#endif
+
+TEST_CASE("async log") {
+  auto path = std::filesystem::temp_directory_path() / "whl_log.txt";
+  std::filesystem::remove(path);
+  {
+    auto log = whl::logger(path, whl::log_policy::block, 4096);
+    auto threads = std::vector<std::thread>{};
+    for (auto t = 0; t < 4; ++t) {
+      threads.emplace_back([&log, t] {
+        for (auto i = 0; i < 1000; ++i) {
+          log.log(WHL_FMT("{} {:03} {:.1f} {} {}"), t, i, i / 2.0, "text", std::vector{t, i});
+        }
+      });
+    }
+    for (auto &&thread : threads) {
+      thread.join();
+    }
+    log.flush();
+    REQUIRE((whl::io::lines(path) | whl::op::count()) == 4000);
+    REQUIRE(log.dropped() == 0);
+  }
+  auto lines = whl::io::lines(path) | whl::op::to<std::vector<std::string>>();
+  REQUIRE(std::count(lines.begin(), lines.end(), "2 007 3.5 text [2, 7]") == 1);
+  REQUIRE(std::count(lines.begin(), lines.end(), "3 999 499.5 text [3, 999]") == 1);
+
+  {
+    auto log = whl::logger(path, whl::log_policy::drop, 1024);
+    auto written = std::size_t{};
+    for (auto i = 0; i < 1000; ++i) {
+      written += log.log(WHL_FMT("{}"), std::string(100, 'x'));
+    }
+    REQUIRE(written + log.dropped() == 1000);
+    REQUIRE(log.log(WHL_FMT("{}"), std::string(2000, 'x')) == false);
+  }
+  {
+    auto log = whl::logger(path, whl::log_policy::block);
+    for (auto i = 0; i < 100; ++i) {
+      auto text = std::to_string(i);
+      log.log(WHL_FMT("{}"), std::array<const char *, 1>{text.c_str()});
+    }
+    log.flush();
+  }
+  lines = whl::io::lines(path) | whl::op::to<std::vector<std::string>>();
+  REQUIRE(lines.back() == "[99]");
+
+  std::filesystem::remove(path);
+  for (auto round = 0; round < 3; ++round) {
+    auto log = whl::logger(path, whl::log_policy::block);
+    for (auto t = 0; t < 100; ++t) {
+      std::thread([&log, t] { log.log(WHL_FMT("{}"), t); }).join();
+    }
+    log.flush();
+  }
+  REQUIRE((whl::io::lines(path) | whl::op::count()) == 300);
+  std::filesystem::remove(path);
+}
+
+namespace {
+
+struct employee {
+  std::string name;
+  int age;
+  std::optional<double> salary;
+};
+
+auto json_fields(const employee &e) {
+  return std::tuple{whl::json_field{"name", e.name}, whl::json_field{"age", e.age}, whl::json_field{"salary", e.salary}};
+}
+
+} // namespace
+
+TEST_CASE("json") {
+  REQUIRE(whl::to_json(std::vector{1, -2, 3}) == "[1,-2,3]");
+  REQUIRE(whl::to_json(std::tuple{true, nullptr, 'c', 0.5, std::nan("")}) == R"([true,null,"c",0.5,null])");
+  REQUIRE(whl::to_json(std::map<std::string, std::pair<int, int>>{{"a", {1, 2}}, {"b", {3, 4}}}) == R"({"a":[1,2],"b":[3,4]})");
+  REQUIRE(whl::to_json(std::map<int, bool>{{1, true}}) == R"({"1":true})");
+  REQUIRE(whl::to_json(std::map<char, int>{{'a', 1}, {'"', 2}}) == R"({"\"":2,"a":1})");
+  REQUIRE(whl::to_json(std::set<std::string>{"x"}) == R"(["x"])");
+  REQUIRE(whl::to_json(employee{"Ann", 30, std::nullopt}) == R"({"name":"Ann","age":30,"salary":null})");
+  REQUIRE(whl::to_json(std::vector{employee{"B", 1, 2.5}}) == R"([{"name":"B","age":1,"salary":2.5}])");
+
+  REQUIRE(whl::to_json("quote\" back\\ tab\t nl\n \x01 end") == R"("quote\" back\\ tab\t nl\n \u0001 end")");
+  auto text = std::string(100, 'a');
+  text[37] = '"';
+  text[80] = '\x1f';
+  auto escaped = whl::to_json(text);
+  REQUIRE(escaped.size() == 102 + 1 + 5);
+  REQUIRE(escaped.substr(37, 4) == R"(a\"a)");
+  REQUIRE(escaped.substr(82, 6) == R"(\u001f)");
+  REQUIRE(whl::to_json(std::string_view("caf\xc3\xa9")) == "\"caf\xc3\xa9\"");
+
+  auto out = std::string{};
+  whl::write_json(std::back_inserter(out), whl::range(0, 3));
+  REQUIRE(out == "[0,1,2]");
+}
+
+TEST_CASE("scan") {
+  auto level = std::string_view{};
+  auto user = std::string{};
+  auto code = 0;
+  auto latency = 0.0;
+  auto ok = false;
+  auto result = whl::scan(WHL_FMT("[{}] user={}; code={:x} took {}ms ok={}"), "[warn] user=ann lee; code=1f took 2.5ms ok=true", level, user, code, latency, ok);
+  REQUIRE(result);
+  REQUIRE(result.count == 5);
+  REQUIRE(level == "warn");
+  REQUIRE(user == "ann lee");
+  REQUIRE(code == 31);
+  REQUIRE(latency == 2.5);
+  REQUIRE(ok);
+
+  auto a = 0, b = 0;
+  auto c = 'x';
+  REQUIRE(whl::scan(WHL_FMT("{} {}{}"), "  +12 \t -7!", a, b, c));
+  REQUIRE(std::tuple{a, b, c} == std::tuple{12, -7, '!'});
+
+  auto word = std::string_view{};
+  auto n = std::uint8_t{};
+  result = whl::scan(WHL_FMT("{} {}"), "id 300", word, n);
+  REQUIRE(result.ec == std::errc::result_out_of_range);
+  REQUIRE(result.count == 1);
+  REQUIRE(result.position == 3);
+  REQUIRE(word == "id");
+
+  result = whl::scan(WHL_FMT("{}, {}"), "5; 6", a, b);
+  REQUIRE(!result);
+  REQUIRE(result.ec == std::errc::invalid_argument);
+  REQUIRE(result.position == 1);
+  REQUIRE(a == 5);
+  REQUIRE(whl::scan(WHL_FMT("{{{}}}"), "{42}", a).count == 1);
+  REQUIRE(a == 42);
+  REQUIRE(whl::scan(WHL_FMT("{}"), "abc", a).ec == std::errc::invalid_argument);
 }
 
 TEST_CASE("others") {